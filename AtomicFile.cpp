@@ -0,0 +1,265 @@
+//Implementation file for AtomicFile class
+
+#include "AtomicFile.h"
+#include "TextEncoding.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Directory holding path, so the temporary file lands on the same volume and rename can replace the target
+std::wstring DirectoryOf(const std::wstring& path)
+{
+#ifdef _WIN32
+    size_t slash = path.find_last_of(L"\\/");
+    if (slash != std::wstring::npos && slash > 0 && path[slash - 1] == L':')
+        return path.substr(0, slash + 1);   // drive root, "C:\"
+#else
+    size_t slash = path.find_last_of(L'/');
+#endif
+    if (slash == std::wstring::npos)
+        return L".";
+    return slash == 0 ? path.substr(0, 1) : path.substr(0, slash);
+}
+
+#ifdef _WIN32
+
+// GetTempFileNameW creates the file under a name no other file (or concurrent save) has
+intptr_t CreateTemp(const std::wstring& targetPath, std::wstring& outPath)
+{
+    wchar_t path[MAX_PATH];
+    if (!GetTempFileNameW(DirectoryOf(targetPath).c_str(), L"cst", 0, path))
+        return -1;
+
+    HANDLE file = CreateFileW(path, GENERIC_WRITE, 0, nullptr, TRUNCATE_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        DeleteFileW(path);
+        return -1;
+    }
+    outPath = path;
+    return reinterpret_cast<intptr_t>(file);
+}
+
+bool WriteAll(intptr_t handle, const char* data, size_t size)
+{
+    HANDLE file = reinterpret_cast<HANDLE>(handle);
+    while (size > 0) {
+        DWORD chunk = size > 0x40000000 ? 0x40000000 : static_cast<DWORD>(size);
+        DWORD written = 0;
+        if (!WriteFile(file, data, chunk, &written, nullptr) || written == 0)
+            return false;
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+bool SyncAndClose(intptr_t handle)
+{
+    HANDLE file = reinterpret_cast<HANDLE>(handle);
+    bool synced = FlushFileBuffers(file) != 0;
+    return CloseHandle(file) != 0 && synced;
+}
+
+void CloseQuietly(intptr_t handle)
+{
+    CloseHandle(reinterpret_cast<HANDLE>(handle));
+}
+
+bool SyncPath(const std::wstring& path)
+{
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    return SyncAndClose(reinterpret_cast<intptr_t>(file));
+}
+
+bool RenameOver(const std::wstring& from, const std::wstring& to)
+{
+    return MoveFileExW(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+}
+
+void RemoveFile(const std::wstring& path)
+{
+    DeleteFileW(path.c_str());
+}
+
+#else
+
+// mkostemp creates the file under a name no other file (or concurrent save) has
+intptr_t CreateTemp(const std::wstring& targetPath, std::wstring& outPath)
+{
+    std::string target = WideToUtf8(targetPath);
+
+    // Keep the permissions of the file being replaced
+    mode_t mode = 0644;
+    struct stat info;
+    if (stat(target.c_str(), &info) == 0)
+        mode = info.st_mode & 07777;
+
+    std::string path = target + ".XXXXXX";
+    int fd = mkostemp(&path[0], O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+    if (fchmod(fd, mode) != 0) {
+        close(fd);
+        unlink(path.c_str());
+        return -1;
+    }
+    outPath = Utf8ToWide(path);
+    return fd;
+}
+
+bool WriteAll(intptr_t handle, const char* data, size_t size)
+{
+    while (size > 0) {
+        ssize_t written = write(static_cast<int>(handle), data, size);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+bool SyncAndClose(intptr_t handle)
+{
+    bool synced = fsync(static_cast<int>(handle)) == 0;
+    return close(static_cast<int>(handle)) == 0 && synced;
+}
+
+void CloseQuietly(intptr_t handle)
+{
+    close(static_cast<int>(handle));
+}
+
+bool SyncPath(const std::wstring& path)
+{
+    int fd = open(WideToUtf8(path).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    return SyncAndClose(fd);
+}
+
+bool RenameOver(const std::wstring& from, const std::wstring& to)
+{
+    if (rename(WideToUtf8(from).c_str(), WideToUtf8(to).c_str()) != 0)
+        return false;
+
+    // Make the rename itself durable
+    SyncPath(DirectoryOf(to));
+    return true;
+}
+
+void RemoveFile(const std::wstring& path)
+{
+    unlink(WideToUtf8(path).c_str());
+}
+
+#endif
+
+} // namespace
+
+//--------------------------------------------------
+// Destructor
+//--------------------------------------------------
+AtomicFile::~AtomicFile() {
+    Discard();
+}
+
+//--------------------------------------------------
+// Create Temp File
+//--------------------------------------------------
+std::wstring AtomicFile::CreateTempFile(const std::wstring& targetPath) {
+    std::wstring path;
+    intptr_t file = CreateTemp(targetPath, path);
+    if (file == -1)
+        return L"";
+    CloseQuietly(file);
+    return path;
+}
+
+//--------------------------------------------------
+// Open
+//--------------------------------------------------
+bool AtomicFile::Open(const std::wstring& path) {
+    Discard();
+
+    targetPath = path;
+    handle = CreateTemp(targetPath, tempPath);
+    failed = handle == -1;
+    return !failed;
+}
+
+//--------------------------------------------------
+// Write
+//--------------------------------------------------
+bool AtomicFile::Write(const char* data, size_t size) {
+    if (handle == -1 || failed)
+        return false;
+    if (!WriteAll(handle, data, size))
+        failed = true;
+    return !failed;
+}
+
+//--------------------------------------------------
+// Commit
+//--------------------------------------------------
+bool AtomicFile::Commit() {
+    if (handle == -1)
+        return false;
+
+    bool ok = !failed;
+    ok = SyncAndClose(handle) && ok;
+    handle = -1;
+
+    ok = ok && RenameOver(tempPath, targetPath);
+    if (!ok)
+        RemoveFile(tempPath);
+    tempPath.clear();
+    return ok;
+}
+
+//--------------------------------------------------
+// Discard
+//--------------------------------------------------
+void AtomicFile::Discard() {
+    if (handle != -1) {
+        CloseQuietly(handle);
+        handle = -1;
+    }
+    if (!tempPath.empty()) {
+        RemoveFile(tempPath);
+        tempPath.clear();
+    }
+}
+
+//--------------------------------------------------
+// Replace
+//--------------------------------------------------
+bool AtomicFile::Replace(const std::wstring& tempPath, const std::wstring& targetPath) {
+    if (!SyncPath(tempPath) || !RenameOver(tempPath, targetPath)) {
+        RemoveFile(tempPath);
+        return false;
+    }
+    return true;
+}
+
+//--------------------------------------------------
+// Remove Temp
+//--------------------------------------------------
+void AtomicFile::RemoveTemp(const std::wstring& tempPath) {
+    RemoveFile(tempPath);
+}
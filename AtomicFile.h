@@ -0,0 +1,40 @@
+//Header for the AtomicFile class. The purpose of the class is to make saving crash-safe: data is written to a
+//temporary file (with a unique name) next to the target, flushed to disk, and only then renamed over the target in one step. A crash or
+//failed save leaves either the old file or the complete new one at the user's path, never a truncated mix.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class AtomicFile {
+public:
+    AtomicFile() = default;
+    ~AtomicFile();      // discards the temporary file unless Commit succeeded
+    AtomicFile(const AtomicFile&) = delete;
+    AtomicFile& operator=(const AtomicFile&) = delete;
+
+    // Create a temporary file for targetPath in the same directory
+    bool Open(const std::wstring& targetPath);
+
+    // Unbuffered; callers should pass large blocks
+    bool Write(const char* data, size_t size);
+
+    // Flush to disk and rename over the target
+    bool Commit();
+    void Discard();
+
+    // For writers that need their own stream (e.g. ZipWriter seeks back to patch headers):
+    // CreateTempFile makes an empty file with a unique name beside targetPath and returns its path
+    // (empty on failure). Write to it yourself, then call Replace (or RemoveTemp if writing failed).
+    static std::wstring CreateTempFile(const std::wstring& targetPath);
+    static bool Replace(const std::wstring& tempPath, const std::wstring& targetPath);
+    static void RemoveTemp(const std::wstring& tempPath);
+
+private:
+    std::wstring targetPath;
+    std::wstring tempPath;
+    intptr_t handle = -1;   // HANDLE on Windows, file descriptor elsewhere
+    bool failed = false;
+};
@@ -0,0 +1,304 @@
+//Implementation file for CostAnalytics class
+
+#include "CostAnalytics.h"
+#include "TableSchema.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <thread>
+
+namespace {
+
+// Rows per chunk handed to a worker thread
+const size_t kChunkRows = 16384;
+
+const double kPi = 3.14159265358979323846;
+
+// Values buffered before they are folded into the centroids
+const size_t kDigestBuffer = 128;
+
+// Heap order: 'a' ranks above 'b'. Used as the comparator so the worst kept entry sits at the front.
+bool RanksAbove(const TopNHeap::Entry& a, const TopNHeap::Entry& b)
+{
+    if (a.value != b.value)
+        return a.value > b.value;
+    return a.index < b.index;
+}
+
+// t-digest scale function k1 and its inverse: centroids near q = 0 and q = 1 stay small
+double ScaleK(double q, double compression)
+{
+    return compression / (2.0 * kPi) * std::asin(2.0 * q - 1.0);
+}
+
+double ScaleQ(double k, double compression)
+{
+    return (std::sin(k * 2.0 * kPi / compression) + 1.0) / 2.0;
+}
+
+} // namespace
+
+//--------------------------------------------------
+// TopNHeap
+//--------------------------------------------------
+TopNHeap::TopNHeap(size_t capacity)
+    : capacity(capacity)
+{
+    heap.reserve(capacity);
+}
+
+void TopNHeap::Add(size_t index, double value) {
+    Entry entry{ index, value };
+    if (heap.size() < capacity) {
+        heap.push_back(entry);
+        std::push_heap(heap.begin(), heap.end(), RanksAbove);
+    } else if (capacity > 0 && RanksAbove(entry, heap.front())) {
+        std::pop_heap(heap.begin(), heap.end(), RanksAbove);
+        heap.back() = entry;
+        std::push_heap(heap.begin(), heap.end(), RanksAbove);
+    }
+}
+
+void TopNHeap::Merge(const TopNHeap& other) {
+    for (const auto& entry : other.heap)
+        Add(entry.index, entry.value);
+}
+
+std::vector<TopNHeap::Entry> TopNHeap::GetSorted() const {
+    std::vector<Entry> sorted = heap;
+    std::sort(sorted.begin(), sorted.end(), RanksAbove);
+    return sorted;
+}
+
+size_t TopNHeap::GetCapacity() const {
+    return capacity;
+}
+
+//--------------------------------------------------
+// TDigest
+//--------------------------------------------------
+TDigest::TDigest(double compression)
+    : compression(compression),
+      minValue(std::numeric_limits<double>::infinity()),
+      maxValue(-std::numeric_limits<double>::infinity())
+{
+}
+
+void TDigest::Add(double value, double weight) {
+    if (!std::isfinite(value) || weight <= 0.0)
+        return;
+
+    buffer.push_back({ value, weight });
+    bufferedWeight += weight;
+    minValue = std::min(minValue, value);
+    maxValue = std::max(maxValue, value);
+
+    if (buffer.size() >= kDigestBuffer)
+        Compress();
+}
+
+void TDigest::Merge(const TDigest& other) {
+    other.Compress();
+    for (const auto& c : other.centroids) {
+        buffer.push_back(c);
+        bufferedWeight += c.weight;
+        if (buffer.size() >= kDigestBuffer)
+            Compress();
+    }
+    minValue = std::min(minValue, other.minValue);
+    maxValue = std::max(maxValue, other.maxValue);
+}
+
+//--------------------------------------------------
+// Compress
+// Sort the buffered values in with the centroids and merge
+// neighbours while the merged centroid stays within one unit
+// of the scale function.
+//--------------------------------------------------
+void TDigest::Compress() const {
+    if (buffer.empty())
+        return;
+
+    buffer.insert(buffer.end(), centroids.begin(), centroids.end());
+    std::sort(buffer.begin(), buffer.end(),
+        [](const Centroid& a, const Centroid& b) { return a.mean < b.mean; });
+
+    double total = 0.0;
+    for (const auto& c : buffer)
+        total += c.weight;
+
+    centroids.clear();
+    Centroid current = buffer[0];
+    double weightBefore = 0.0;
+    double limit = total * ScaleQ(ScaleK(0.0, compression) + 1.0, compression);
+
+    for (size_t i = 1; i < buffer.size(); ++i) {
+        const Centroid& next = buffer[i];
+        if (weightBefore + current.weight + next.weight <= limit) {
+            current.weight += next.weight;
+            current.mean += (next.mean - current.mean) * next.weight / current.weight;
+        } else {
+            weightBefore += current.weight;
+            centroids.push_back(current);
+            limit = total * ScaleQ(ScaleK(weightBefore / total, compression) + 1.0, compression);
+            current = next;
+        }
+    }
+    centroids.push_back(current);
+
+    buffer.clear();
+    totalWeight = total;
+    bufferedWeight = 0.0;
+}
+
+//--------------------------------------------------
+// Get Quantile
+// Each centroid's mean is taken to sit at the middle of its
+// weight; between two centres the value is interpolated, and
+// the ends are interpolated towards the exact min and max.
+//--------------------------------------------------
+double TDigest::GetQuantile(double q) const {
+    Compress();
+    if (centroids.empty())
+        return std::numeric_limits<double>::quiet_NaN();
+
+    if (q <= 0.0)
+        return minValue;
+    if (q >= 1.0)
+        return maxValue;
+    if (centroids.size() == 1)
+        return centroids[0].mean;
+
+    double target = q * totalWeight;
+
+    // Left tail: between the minimum and the first centre
+    const Centroid& first = centroids.front();
+    if (target < first.weight / 2.0) {
+        if (first.weight == 1.0)
+            return minValue;
+        return minValue + (first.mean - minValue) * target / (first.weight / 2.0);
+    }
+
+    double cumulative = first.weight / 2.0;  // weight up to the centre of centroid i
+    for (size_t i = 0; i + 1 < centroids.size(); ++i) {
+        const Centroid& a = centroids[i];
+        const Centroid& b = centroids[i + 1];
+        double gap = (a.weight + b.weight) / 2.0;
+        if (target < cumulative + gap) {
+            // Singletons are exact values; do not smear them
+            double leftSingle = a.weight == 1.0 ? 0.5 : 0.0;
+            double rightSingle = b.weight == 1.0 ? 0.5 : 0.0;
+            double offset = target - cumulative;
+            if (offset < leftSingle)
+                return a.mean;
+            if (offset > gap - rightSingle)
+                return b.mean;
+            double span = gap - leftSingle - rightSingle;
+            if (span <= 0.0)
+                return a.mean;
+            return a.mean + (b.mean - a.mean) * (offset - leftSingle) / span;
+        }
+        cumulative += gap;
+    }
+
+    // Right tail: between the last centre and the maximum
+    const Centroid& last = centroids.back();
+    if (last.weight == 1.0)
+        return maxValue;
+    double offset = target - cumulative;
+    return last.mean + (maxValue - last.mean) * std::min(1.0, offset / (last.weight / 2.0));
+}
+
+double TDigest::GetCount() const {
+    return totalWeight + bufferedWeight;
+}
+
+double TDigest::GetMin() const {
+    return minValue;
+}
+
+double TDigest::GetMax() const {
+    return maxValue;
+}
+
+//--------------------------------------------------
+// Accumulator
+//--------------------------------------------------
+CostAnalytics::Accumulator::Accumulator(const Options& options)
+    : measure(options.measure), byCategory(options.byCategory), top(options.topCount)
+{
+}
+
+void CostAnalytics::Accumulator::Add(size_t index, const DataRow& row) {
+    double value = 0.0;
+    bool parsed = false;
+    switch (measure) {
+        case Measure::Cost:     parsed = CostTrackerSchema::Parse<CostTrackerColumns::Cost>(row, value); break;
+        case Measure::Quantity: parsed = CostTrackerSchema::Parse<CostTrackerColumns::Quantity>(row, value); break;
+        case Measure::UnitCost: parsed = CostTrackerSchema::Parse<CostTrackerColumns::UnitCost>(row, value); break;
+    }
+    if (!parsed) {
+        skipped++;
+        return;
+    }
+
+    top.Add(index, value);
+    overall.Add(value);
+    if (byCategory)
+        categories[row.category].Add(value);
+}
+
+void CostAnalytics::Accumulator::Merge(const Accumulator& other) {
+    top.Merge(other.top);
+    overall.Merge(other.overall);
+    for (const auto& entry : other.categories)
+        categories[entry.first].Merge(entry.second);
+    skipped += other.skipped;
+}
+
+CostAnalytics::Result CostAnalytics::Accumulator::GetResult() const {
+    Result result;
+    result.top = top.GetSorted();
+    result.overall = overall;
+    result.categories = categories;
+    result.skipped = skipped;
+    return result;
+}
+
+//--------------------------------------------------
+// Analyze (parallel over chunks)
+//--------------------------------------------------
+CostAnalytics::Result CostAnalytics::Analyze(const VersionedRowStore::Snapshot& rows, const Options& options) {
+    size_t count = rows.GetRowCount();
+    size_t chunks = (count + kChunkRows - 1) / kChunkRows;
+    unsigned threads = options.threadCount ? options.threadCount : std::max(1u, std::thread::hardware_concurrency());
+    threads = static_cast<unsigned>(std::min<size_t>(threads, chunks));
+
+    if (threads <= 1) {
+        Accumulator accumulator(options);
+        for (size_t i = 0; i < count; ++i)
+            accumulator.Add(i, rows.GetRow(i));
+        return accumulator.GetResult();
+    }
+
+    // One accumulator per thread; each holds at most topCount entries and a few KB per digest
+    std::vector<Accumulator> partial(threads, Accumulator(options));
+    std::vector<std::thread> pool;
+
+    for (unsigned t = 0; t < threads; t++) {
+        pool.emplace_back([&, t]() {
+            for (size_t c = t; c < chunks; c += threads) {
+                size_t begin = c * kChunkRows;
+                size_t end = std::min(begin + kChunkRows, count);
+                for (size_t i = begin; i < end; ++i)
+                    partial[t].Add(i, rows.GetRow(i));
+            }
+        });
+    }
+    for (auto& thread : pool)
+        thread.join();
+
+    for (unsigned t = 1; t < threads; t++)
+        partial[0].Merge(partial[t]);
+    return partial[0].GetResult();
+}
@@ -0,0 +1,109 @@
+//Header for the CostAnalytics class. The purpose of the class is to answer the questions reviewers ask about a
+//sheet beyond the total: the N most expensive line items (exact, kept in bounded heaps) and the median, p95 or any
+//other quantile of cost (approximate, kept in a t-digest), overall or per category. Everything is gathered in a
+//single pass; the rows are split into chunks across threads and the per-thread results merged at the end.
+
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+#include "DataRow.h"
+#include "VersionedRowStore.h"
+
+// Exact top-N: a min-heap of at most N entries, so the smallest kept value is replaced first
+class TopNHeap {
+public:
+    struct Entry {
+        size_t index;       // row index in the table
+        double value;
+    };
+
+    explicit TopNHeap(size_t capacity = 50);
+
+    void Add(size_t index, double value);
+    void Merge(const TopNHeap& other);
+
+    // Largest first; ties keep the earlier row first
+    std::vector<Entry> GetSorted() const;
+    size_t GetCapacity() const;
+
+private:
+    size_t capacity;
+    std::vector<Entry> heap;
+};
+
+// Approximate quantiles: a merging t-digest. Values are buffered and folded into at most about
+// 'compression' centroids, smallest near the tails, so p95 / p99 stay accurate. About 3 KB of state.
+// Queries fold pending values in first, so a digest must not be queried from two threads at once.
+class TDigest {
+public:
+    explicit TDigest(double compression = 100.0);
+
+    void Add(double value, double weight = 1.0);
+    void Merge(const TDigest& other);
+
+    // q in [0, 1]; returns NaN when empty
+    double GetQuantile(double q) const;
+    double GetCount() const;
+    double GetMin() const;
+    double GetMax() const;
+
+private:
+    struct Centroid {
+        double mean;
+        double weight;
+    };
+
+    void Compress() const;
+
+    double compression;
+    mutable std::vector<Centroid> centroids;    // merged, sorted by mean
+    mutable std::vector<Centroid> buffer;       // not yet merged
+    mutable double totalWeight = 0.0;           // of centroids
+    mutable double bufferedWeight = 0.0;
+    double minValue;
+    double maxValue;
+};
+
+class CostAnalytics {
+public:
+    enum class Measure { Cost, Quantity, UnitCost };
+
+    struct Options {
+        Measure measure = Measure::Cost;
+        size_t topCount = 50;
+        bool byCategory = false;        // also keep a digest per category
+        unsigned threadCount = 0;       // 0 = one per core
+    };
+
+    struct Result {
+        std::vector<TopNHeap::Entry> top;
+        TDigest overall;
+        std::map<std::wstring, TDigest> categories;
+        size_t skipped = 0;             // rows whose value is not a number
+    };
+
+    // Streaming form: feed rows one at a time (e.g. from PagedRowStore::ForEachRow),
+    // or build one per thread and Merge them.
+    class Accumulator {
+    public:
+        explicit Accumulator(const Options& options);
+
+        void Add(size_t index, const DataRow& row);
+        void Merge(const Accumulator& other);
+        Result GetResult() const;
+
+    private:
+        Measure measure;
+        bool byCategory;
+        TopNHeap top;
+        TDigest overall;
+        std::map<std::wstring, TDigest> categories;
+        size_t skipped = 0;
+    };
+
+    // One pass over a snapshot, split across threads
+    static Result Analyze(const VersionedRowStore::Snapshot& rows, const Options& options);
+};
@@ -0,0 +1,423 @@
+//Implementation file for CsvFollower class
+
+#include "CsvFollower.h"
+#include "SpreadsheetStorage.h"
+#include "TextEncoding.h"
+#include "ZipArchive.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Bytes checksummed at the start of the file and just before the read position.
+// Enough to notice a rewrite without re-reading everything on every change.
+const uint64_t kCheckWindow = 4096;
+
+// Bytes read from the file at a time
+const size_t kReadBlock = 1 << 20;
+
+std::wstring DirectoryOf(const std::wstring& path)
+{
+    size_t slash = path.find_last_of(L"/\\");
+    if (slash == std::wstring::npos)
+        return L".";
+    if (slash == 0)
+        return path.substr(0, 1);
+    return path.substr(0, slash);
+}
+
+// Identity of the file behind a path; changes when the file is replaced.
+// Windows has no cheap equivalent, so there the checksums do the work.
+uint64_t FileIdentity(const std::wstring& path)
+{
+#ifdef _WIN32
+    (void)path;
+    return 0;
+#else
+    struct stat info;
+    if (stat(WideToUtf8(path).c_str(), &info) != 0)
+        return 0;
+    return static_cast<uint64_t>(info.st_ino) ^ (static_cast<uint64_t>(info.st_dev) << 48);
+#endif
+}
+
+} // namespace
+
+//--------------------------------------------------
+// Watcher
+// Blocks until the file's directory changes, the poll
+// interval passes, or Stop is called. Falls back to plain
+// polling when no change notification can be set up.
+//--------------------------------------------------
+struct CsvFollower::Watcher {
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+
+#ifdef _WIN32
+    HANDLE change = INVALID_HANDLE_VALUE;
+    HANDLE stopEvent = nullptr;
+#elif defined(__linux__)
+    int inotifyFd = -1;
+    int stopFd = -1;
+    std::string fileName;
+#endif
+
+    explicit Watcher(const std::wstring& filePath)
+    {
+        std::wstring directory = DirectoryOf(filePath);
+#ifdef _WIN32
+        stopEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        change = FindFirstChangeNotificationW(directory.c_str(), FALSE,
+            FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
+#elif defined(__linux__)
+        stopFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        inotifyFd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+        // Watch the directory rather than the file so a file replaced by rename is seen too
+        if (inotifyFd >= 0 && inotify_add_watch(inotifyFd, WideToUtf8(directory).c_str(),
+                IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM) < 0) {
+            close(inotifyFd);
+            inotifyFd = -1;
+        }
+        size_t slash = filePath.find_last_of(L"/\\");
+        fileName = WideToUtf8(slash == std::wstring::npos ? filePath : filePath.substr(slash + 1));
+#else
+        (void)directory;
+#endif
+    }
+
+    ~Watcher()
+    {
+#ifdef _WIN32
+        if (change != INVALID_HANDLE_VALUE)
+            FindCloseChangeNotification(change);
+        if (stopEvent)
+            CloseHandle(stopEvent);
+#elif defined(__linux__)
+        if (inotifyFd >= 0)
+            close(inotifyFd);
+        if (stopFd >= 0)
+            close(stopFd);
+#endif
+    }
+
+    void Signal()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+#ifdef _WIN32
+        if (stopEvent)
+            SetEvent(stopEvent);
+#elif defined(__linux__)
+        if (stopFd >= 0) {
+            uint64_t one = 1;
+            ssize_t written = write(stopFd, &one, sizeof(one));
+            (void)written;
+        }
+#endif
+    }
+
+    // Returns false once Stop has been requested
+    bool Wait(unsigned milliseconds)
+    {
+#ifdef _WIN32
+        if (change != INVALID_HANDLE_VALUE && stopEvent) {
+            HANDLE handles[2] = { stopEvent, change };
+            DWORD result = WaitForMultipleObjects(2, handles, FALSE, milliseconds);
+            if (result == WAIT_OBJECT_0 + 1)
+                FindNextChangeNotification(change);
+            return result != WAIT_OBJECT_0;
+        }
+#elif defined(__linux__)
+        if (inotifyFd >= 0 && stopFd >= 0) {
+            for (;;) {
+                pollfd fds[2] = { { stopFd, POLLIN, 0 }, { inotifyFd, POLLIN, 0 } };
+                int ready = poll(fds, 2, static_cast<int>(milliseconds));
+                if (ready < 0 || (fds[0].revents & POLLIN))
+                    return false;
+                if (ready == 0)
+                    return true;    // interval passed; check anyway
+
+                // Drain the queue and only wake for events on our file
+                bool ours = false;
+                alignas(inotify_event) char buffer[4096];
+                ssize_t length;
+                while ((length = read(inotifyFd, buffer, sizeof(buffer))) > 0) {
+                    for (char* p = buffer; p < buffer + length; ) {
+                        inotify_event* event = reinterpret_cast<inotify_event*>(p);
+                        if (event->len == 0 || fileName == event->name)
+                            ours = true;
+                        p += sizeof(inotify_event) + event->len;
+                    }
+                }
+                if (ours)
+                    return true;
+            }
+        }
+#endif
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait_for(lock, std::chrono::milliseconds(milliseconds), [this]() { return stopping; });
+        return !stopping;
+    }
+};
+
+//--------------------------------------------------
+// Constructor / Destructor
+//--------------------------------------------------
+CsvFollower::CsvFollower() = default;
+
+CsvFollower::~CsvFollower() {
+    Stop();
+}
+
+//--------------------------------------------------
+// Start
+//--------------------------------------------------
+bool CsvFollower::Start(const std::wstring& filePath, BatchCallback onBatch, unsigned pollMilliseconds) {
+    Stop();
+
+    path = filePath;
+    Reset();
+
+    std::ifstream probe;
+    OpenFileStream(probe, path, std::ios::in | std::ios::binary);
+    if (!probe.is_open())
+        return false;
+    probe.close();
+
+    watcher.reset(new Watcher(path));
+    running = true;
+    thread = std::thread(&CsvFollower::WatchLoop, this, std::move(onBatch), pollMilliseconds);
+    return true;
+}
+
+//--------------------------------------------------
+// Stop
+//--------------------------------------------------
+void CsvFollower::Stop() {
+    if (watcher)
+        watcher->Signal();
+    if (thread.joinable())
+        thread.join();
+    watcher.reset();
+    running = false;
+}
+
+//--------------------------------------------------
+// Is Running / Get Path
+//--------------------------------------------------
+bool CsvFollower::IsRunning() const {
+    return running;
+}
+
+const std::wstring& CsvFollower::GetPath() const {
+    return path;
+}
+
+//--------------------------------------------------
+// Watch Loop (follower thread)
+//--------------------------------------------------
+void CsvFollower::WatchLoop(BatchCallback onBatch, unsigned pollMilliseconds) {
+    do {
+        Batch batch;
+        if (ReadChanges(batch) && (batch.reload || !batch.rows.empty()))
+            onBatch(std::move(batch));
+    } while (watcher->Wait(pollMilliseconds));
+}
+
+//--------------------------------------------------
+// Reset
+//--------------------------------------------------
+void CsvFollower::Reset() {
+    fileId = 0;
+    offset = 0;
+    headChecksum = 0;
+    headLength = 0;
+    tailChecksum = 0;
+    nextLine = 1;
+    initialLoadDone = false;
+    mapping = ColumnMapping();
+}
+
+//--------------------------------------------------
+// Checksum of bytes [begin, end)
+//--------------------------------------------------
+uint32_t CsvFollower::Checksum(std::ifstream& file, uint64_t begin, uint64_t end) const {
+    char buffer[kCheckWindow];
+    size_t length = static_cast<size_t>(end - begin);
+    file.clear();
+    file.seekg(static_cast<std::streamoff>(begin));
+    file.read(buffer, static_cast<std::streamsize>(length));
+    if (static_cast<size_t>(file.gcount()) != length)
+        return ~ZipCrc32(0, buffer, static_cast<size_t>(file.gcount()));    // cannot match
+    return ZipCrc32(0, buffer, length);
+}
+
+//--------------------------------------------------
+// Prefix Unchanged
+// True when the bytes already read are still there: same
+// file, not shorter, and the start of the file and the
+// bytes just before the read position still match.
+//--------------------------------------------------
+bool CsvFollower::PrefixUnchanged(std::ifstream& file, uint64_t fileSize) const {
+    if (fileSize < offset)
+        return false;   // truncated
+    if (FileIdentity(path) != fileId)
+        return false;   // replaced
+    if (Checksum(file, 0, headLength) != headChecksum)
+        return false;
+
+    uint64_t tailBegin = offset - std::min(offset, kCheckWindow);
+    return Checksum(file, tailBegin, offset) == tailChecksum;
+}
+
+//--------------------------------------------------
+// Parse one record (without its newline) into the batch.
+// A record spans several lines when a quoted field holds
+// line breaks.
+//--------------------------------------------------
+void CsvFollower::ParseLine(const char* begin, const char* end, Batch& outBatch) {
+    size_t lineNumber = nextLine;
+    nextLine += 1 + static_cast<size_t>(std::count(begin, end, '\n'));
+
+    if (end > begin && end[-1] == '\r')
+        end--;
+
+    std::wstring line;
+    AppendTextLine(line, begin, static_cast<size_t>(end - begin));
+    int unclosedField = -1;
+    std::vector<std::wstring> fields = SpreadsheetStorage::ParseCSVLine(line, &unclosedField);
+
+    if (lineNumber == 1) {
+        mapping = ColumnMapping(fields);
+        return;
+    }
+    if (unclosedField >= 0)
+        outBatch.issues.push_back(SpreadsheetStorage::UnclosedQuoteIssue(mapping, unclosedField, lineNumber));
+
+    DataRow row;
+    if (!mapping.Decode(fields, row))
+        return;
+
+    outBatch.rows.push_back(std::move(row));
+    outBatch.lineNumbers.push_back(lineNumber);
+}
+
+//--------------------------------------------------
+// Read Changes
+// Only complete records are consumed; one still being
+// written (no newline yet, or an open quoted field) is
+// picked up on the next call. A quote still open after
+// kMaxRecordLines lines is a stray one, and the record
+// is taken to end with its first line.
+//--------------------------------------------------
+bool CsvFollower::ReadChanges(Batch& outBatch) {
+    outBatch = Batch();
+
+    std::ifstream file;
+    OpenFileStream(file, path, std::ios::in | std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    file.seekg(0, std::ios::end);
+    uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+
+    // An empty or header-only file leaves offset at 0, so it cannot mark the first read
+    if (!initialLoadDone || !PrefixUnchanged(file, fileSize)) {
+        Reset();
+        outBatch.reload = true;
+    }
+    initialLoadDone = true;
+    bool headerRead = nextLine > 1;
+
+    if (fileSize == offset && !outBatch.reload)
+        return true;
+
+    std::vector<char> buffer;
+    size_t carried = 0;         // bytes of an unfinished line kept from the previous block
+    uint64_t bufferStart = offset;  // file position of buffer[0]
+
+    file.clear();
+    file.seekg(static_cast<std::streamoff>(offset));
+
+    while (bufferStart + carried < fileSize) {
+        size_t want = static_cast<size_t>(std::min<uint64_t>(kReadBlock, fileSize - bufferStart - carried));
+        buffer.resize(carried + want);
+        file.read(buffer.data() + carried, static_cast<std::streamsize>(want));
+        size_t got = static_cast<size_t>(file.gcount());
+        if (got == 0)
+            break;
+
+        const char* data = buffer.data();
+        size_t length = carried + got;
+        size_t lineStart = 0;
+
+        // Skip a UTF-8 byte order mark at the very start
+        if (bufferStart == 0 && length >= 3 && std::memcmp(data, "\xEF\xBB\xBF", 3) == 0)
+            lineStart = 3;
+
+        // A newline inside a quoted field does not end the record
+        using QuoteState = SpreadsheetStorage::CSVQuoteState;
+        size_t scan = lineStart;
+        QuoteState state = QuoteState::FieldStart;
+        size_t recordLines = 0;
+        size_t firstLineEnd = 0;
+        const char* newline;
+        while ((newline = static_cast<const char*>(std::memchr(data + scan, '\n', length - scan))) != nullptr) {
+            size_t lineEnd = static_cast<size_t>(newline - data);
+            state = SpreadsheetStorage::ScanCSVQuotes(data + scan, newline, state);
+            scan = lineEnd + 1;
+            if (++recordLines == 1)
+                firstLineEnd = lineEnd;
+            if (state == QuoteState::Quoted) {
+                if (recordLines < SpreadsheetStorage::kMaxRecordLines)
+                    continue;
+                lineEnd = firstLineEnd;
+                scan = firstLineEnd + 1;
+            }
+            state = QuoteState::FieldStart;
+            recordLines = 0;
+
+            ParseLine(data + lineStart, data + lineEnd, outBatch);
+            lineStart = scan;
+            offset = bufferStart + lineStart;
+        }
+
+        carried = length - lineStart;
+        std::memmove(buffer.data(), data + lineStart, carried);
+        bufferStart += lineStart;
+    }
+
+    // A header written after the first read still sets the columns
+    if (!headerRead && nextLine > 1)
+        outBatch.reload = true;
+    if (outBatch.reload)
+        mapping.InferTypes(outBatch.rows);
+    outBatch.schema = mapping.GetSchema();
+
+    // Remember what the consumed bytes looked like
+    fileId = FileIdentity(path);
+    headLength = std::min(offset, kCheckWindow);
+    headChecksum = Checksum(file, 0, headLength);
+    tailChecksum = Checksum(file, offset - std::min(offset, kCheckWindow), offset);
+    return true;
+}
@@ -0,0 +1,75 @@
+//Header for the CsvFollower class. The purpose of the class is to follow a CSV file that another program keeps
+//appending to, like a log. The follower remembers how far into the file it has read and a checksum of what it
+//read, waits for the file to change (inotify on Linux, change notifications on Windows, polling otherwise), and
+//parses only the new lines. If the file was truncated or rewritten the checksum no longer matches and the whole
+//file is read again.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "DataRow.h"
+#include "TableSchema.h"
+
+class CsvFollower {
+public:
+    struct Batch {
+        bool reload = false;                // the file was read from the start; replace all rows
+        std::vector<DataRow> rows;
+        std::vector<size_t> lineNumbers;    // file line of each row, for ImportValidator
+        TableSchema schema;                 // columns from the header row, for checking the rows
+        std::vector<ImportIssue> issues;    // problems with the file's layout (ImportValidator adds to these)
+    };
+
+    // Called on the follower's thread
+    using BatchCallback = std::function<void(Batch&& batch)>;
+
+    CsvFollower();
+    ~CsvFollower();
+    CsvFollower(const CsvFollower&) = delete;
+    CsvFollower& operator=(const CsvFollower&) = delete;
+
+    // Read the whole file once, then keep delivering appended rows until Stop.
+    // pollMilliseconds is the polling interval when no change notification is available,
+    // and a safety net (e.g. network drives) when one is.
+    bool Start(const std::wstring& filePath, BatchCallback onBatch, unsigned pollMilliseconds = 1000);
+    void Stop();
+    bool IsRunning() const;
+    const std::wstring& GetPath() const;
+
+    // One check without a thread. The first call (or one after a truncate or rewrite)
+    // returns every row with reload set; later calls return only complete records appended
+    // since the previous call. Returns false if the file could not be read.
+    bool ReadChanges(Batch& outBatch);
+
+    // Forget the read position so the next ReadChanges reloads the file
+    void Reset();
+
+private:
+    struct Watcher;
+
+    bool PrefixUnchanged(std::ifstream& file, uint64_t fileSize) const;
+    uint32_t Checksum(std::ifstream& file, uint64_t begin, uint64_t end) const;
+    void ParseLine(const char* begin, const char* end, Batch& outBatch);
+    void WatchLoop(BatchCallback onBatch, unsigned pollMilliseconds);
+
+    std::wstring path;
+    uint64_t fileId = 0;            // inode where available, so a replaced file is noticed
+    uint64_t offset = 0;            // end of the last complete line read
+    uint32_t headChecksum = 0;      // first bytes of the file (up to kCheckWindow)
+    uint64_t headLength = 0;
+    uint32_t tailChecksum = 0;      // last bytes before offset (up to kCheckWindow)
+    size_t nextLine = 1;
+    bool initialLoadDone = false;   // the file has been read from the start at least once
+    ColumnMapping mapping;          // from the header row
+
+    std::unique_ptr<Watcher> watcher;
+    std::thread thread;
+    std::atomic<bool> running{ false };
+};
@@ -0,0 +1,20 @@
+//Header for the DataRow struct. The purpose of the struct is to hold one line item of the spreadsheet.
+//It lives apart from DataTable so code that only works with rows does not need the Windows headers.
+
+#pragma once
+#include <string>
+#include <vector>
+
+struct DataRow {
+    std::wstring category;
+    std::wstring item;
+    std::wstring material;
+    std::wstring description;
+    std::wstring quantity;
+    std::wstring unitCost;
+    std::wstring cost;
+    std::wstring notes;
+
+    // Columns beyond the built-in ones, in TableSchema order (see TableSchema.h)
+    std::vector<std::wstring> extra;
+};
@@ -5,6 +5,13 @@
 
 #pragma comment(lib, "comctl32.lib")
 
+namespace {
+
+// Rows read from a paged sheet around the part of the list being drawn
+const size_t kPagedWindowRows = 256;
+
+} // namespace
+
 //--------------------------------------------------
 // Constructor
 //--------------------------------------------------
@@ -20,7 +27,7 @@ DataTable::DataTable(HWND parent, int x, int y, int width, int height)
         WS_EX_CLIENTEDGE,
         WC_LISTVIEWW,
         L"",
-        WS_CHILD | WS_VISIBLE | LVS_REPORT | LVS_SINGLESEL | LVS_SHOWSELALWAYS,
+        WS_CHILD | WS_VISIBLE | LVS_REPORT | LVS_SINGLESEL | LVS_SHOWSELALWAYS | LVS_OWNERDATA,
         x, y, width, height,
         hParent,
         nullptr,
@@ -51,64 +58,205 @@ DataTable::~DataTable() {
 // Column setup
 //--------------------------------------------------
 void DataTable::InitializeColumns() {
-    const wchar_t* headers[] = {
-        L"Category", L"Item", L"Material", L"Description",
-        L"Quantity", L"Unit Cost", L"Cost", L"Notes"
-    };
-
-    int widths[] = { 100, 120, 120, 200, 70, 90, 90, 200 };
+    int schemaColumns = static_cast<int>(schema.GetColumnCount());
 
-    for (int i = 0; i < 8; ++i) {
+    for (int i = 0; i < schemaColumns; ++i) {
+        const ColumnInfo& info = schema.GetColumn(i);
         LVCOLUMNW col{};
         col.mask = LVCF_TEXT | LVCF_WIDTH | LVCF_SUBITEM;
-        col.pszText = const_cast<LPWSTR>(headers[i]);
-        col.cx = widths[i];
+        col.pszText = const_cast<LPWSTR>(info.name.c_str());
+        col.cx = info.width;
         col.iSubItem = i;
         ListView_InsertColumn(hListView, i, &col);
     }
+
+    // Computed columns follow the schema columns
+    for (int c = 0; c < formulas.GetColumnCount(); ++c) {
+        LVCOLUMNW col{};
+        col.mask = LVCF_TEXT | LVCF_WIDTH | LVCF_SUBITEM;
+        col.pszText = const_cast<LPWSTR>(formulas.GetColumnName(c).c_str());
+        col.cx = 90;
+        col.iSubItem = schemaColumns + c;
+        ListView_InsertColumn(hListView, schemaColumns + c, &col);
+    }
 }
 
 //--------------------------------------------------
 // Refresh ListView
+// The list is virtual, so this only sets the item count
+// and repaints; text is fetched as rows are drawn.
 //--------------------------------------------------
 void DataTable::RefreshList() {
-    ListView_DeleteAllItems(hListView);
-
-    for (size_t i = 0; i < rows.size(); ++i) {
-        const DataRow& r = rows[i];
-
-        LVITEMW item{};
-        item.mask = LVIF_TEXT;
-        item.iItem = static_cast<int>(i);
-        item.iSubItem = 0;
-        item.pszText = const_cast<LPWSTR>(r.category.c_str());
-        ListView_InsertItem(hListView, &item);
-
-        ListView_SetItemText(hListView, item.iItem, 1, const_cast<LPWSTR>(r.item.c_str()));
-        ListView_SetItemText(hListView, item.iItem, 2, const_cast<LPWSTR>(r.material.c_str()));
-        ListView_SetItemText(hListView, item.iItem, 3, const_cast<LPWSTR>(r.description.c_str()));
-        ListView_SetItemText(hListView, item.iItem, 4, const_cast<LPWSTR>(r.quantity.c_str()));
-        ListView_SetItemText(hListView, item.iItem, 5, const_cast<LPWSTR>(r.unitCost.c_str()));
-        ListView_SetItemText(hListView, item.iItem, 6, const_cast<LPWSTR>(r.cost.c_str()));
-        ListView_SetItemText(hListView, item.iItem, 7, const_cast<LPWSTR>(r.notes.c_str()));
+    ListView_SetItemCountEx(hListView, GetRowCount(), LVSICF_NOSCROLL);
+    InvalidateRect(hListView, nullptr, FALSE);
+}
+
+//--------------------------------------------------
+// Show rows [first, end) added at the end of the list
+//--------------------------------------------------
+void DataTable::InsertItems(size_t first) {
+    int count = GetRowCount();
+    ListView_SetItemCountEx(hListView, count, LVSICF_NOINVALIDATEALL | LVSICF_NOSCROLL);
+    if (static_cast<int>(first) < count)
+        ListView_RedrawItems(hListView, static_cast<int>(first), count - 1);
+}
+
+//--------------------------------------------------
+// Redraw one ListView row
+//--------------------------------------------------
+void DataTable::RefreshRow(int index) {
+    ListView_RedrawItems(hListView, index, index);
+}
+
+//--------------------------------------------------
+// Redraw the rows whose computed cells changed in the last edit
+//--------------------------------------------------
+void DataTable::RefreshComputedCells() {
+    const auto& cells = formulas.GetChangedCells();
+    if (cells.empty()) return;
+
+    int first = cells[0].row, last = cells[0].row;
+    for (const auto& cell : cells) {
+        first = std::min(first, cell.row);
+        last = std::max(last, cell.row);
+    }
+    ListView_RedrawItems(hListView, first, last);
+}
+
+//--------------------------------------------------
+// Handle Notify (virtual list view)
+//--------------------------------------------------
+bool DataTable::HandleNotify(const NMHDR* header) {
+    if (!header || header->hwndFrom != hListView) return false;
+
+    switch (header->code) {
+        case LVN_GETDISPINFOW: {
+            LVITEMW& item = const_cast<NMLVDISPINFOW*>(reinterpret_cast<const NMLVDISPINFOW*>(header))->item;
+            if (item.mask & LVIF_TEXT)
+                GetItemText(item);
+            return true;
+        }
+
+        case LVN_ODCACHEHINT: {
+            // Read the rows about to be drawn in one go rather than one GETDISPINFO at a time
+            const NMLVCACHEHINT* hint = reinterpret_cast<const NMLVCACHEHINT*>(header);
+            if (paged && hint->iFrom >= 0 && hint->iTo >= hint->iFrom) {
+                size_t from = static_cast<size_t>(hint->iFrom);
+                size_t to = static_cast<size_t>(hint->iTo);
+                if (from < pagedWindowFirst || to >= pagedWindowFirst + pagedWindow.size())
+                    LoadPagedWindow(from, std::max(to - from + 1, kPagedWindowRows));
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+//--------------------------------------------------
+// Get Item Text (one cell, on demand)
+//--------------------------------------------------
+void DataTable::GetItemText(LVITEMW& item) {
+    if (!item.pszText || item.cchTextMax <= 0 || item.iItem < 0) return;
+    item.pszText[0] = L'\0';
+
+    size_t index = static_cast<size_t>(item.iItem);
+    size_t column = static_cast<size_t>(item.iSubItem);
+    size_t schemaColumns = schema.GetColumnCount();
+
+    if (column >= schemaColumns) {
+        int computed = static_cast<int>(column - schemaColumns);
+        if (computed < formulas.GetColumnCount() && item.iItem < formulas.GetRowCount())
+            lstrcpynW(item.pszText, formulas.GetText(item.iItem, computed).c_str(), item.cchTextMax);
+        return;
     }
+
+    if (paged) {
+        const DataRow* row = GetPagedRow(index);
+        if (row)
+            lstrcpynW(item.pszText, schema.GetField(*row, column).c_str(), item.cchTextMax);
+        return;
+    }
+
+    VersionedRowStore::Snapshot snapshot = rows.GetSnapshot();
+    if (index < snapshot.GetRowCount())
+        lstrcpynW(item.pszText, schema.GetField(snapshot.GetRow(index), column).c_str(), item.cchTextMax);
+}
+
+//--------------------------------------------------
+// Paged rows around the visible part of the list
+//--------------------------------------------------
+const DataRow* DataTable::GetPagedRow(size_t index) {
+    if (index < pagedWindowFirst || index >= pagedWindowFirst + pagedWindow.size())
+        LoadPagedWindow(index, kPagedWindowRows);
+
+    if (index < pagedWindowFirst || index >= pagedWindowFirst + pagedWindow.size())
+        return nullptr;
+    return &pagedWindow[index - pagedWindowFirst];
+}
+
+void DataTable::LoadPagedWindow(size_t first, size_t count) {
+    pagedWindowFirst = first;
+    paged->GetRows(first, count, pagedWindow);
 }
 
 //--------------------------------------------------
 // Add Row
 //--------------------------------------------------
 void DataTable::AddRow(const DataRow& row) {
-    rows.push_back(row);
+    if (paged) {
+        size_t first = paged->GetRowCount();
+        paged->AppendRow(row);
+        InsertItems(first);
+        return;
+    }
+
+    rows.Append(row);
+    formulas.AppendRow(row);
     RefreshList();
 }
 
+//--------------------------------------------------
+// Add Rows (batch append, e.g. new lines of a followed file)
+//--------------------------------------------------
+void DataTable::AddRows(const std::vector<DataRow>& newRows) {
+    if (newRows.empty()) return;
+
+    if (paged) {
+        size_t first = paged->GetRowCount();
+        for (const auto& row : newRows)
+            paged->AppendRow(row);
+        InsertItems(first);
+        return;
+    }
+
+    size_t first = rows.GetRowCount();
+    rows.Append(newRows);
+    formulas.AppendRows(newRows);
+
+    // Show the new rows, and redraw older ones whose computed cells (e.g. totals) changed
+    InsertItems(first);
+    RefreshComputedCells();
+}
+
 //--------------------------------------------------
 // Update Row
 //--------------------------------------------------
 void DataTable::UpdateRow(int index, const DataRow& row) {
-    if (index < 0 || index >= static_cast<int>(rows.size())) return;
-    rows[index] = row;
-    RefreshList();
+    if (index < 0) return;
+
+    if (paged) {
+        if (!paged->UpdateRow(static_cast<size_t>(index), row)) return;
+        pagedWindow.clear();
+        RefreshRow(index);
+        return;
+    }
+
+    if (!rows.Update(static_cast<size_t>(index), row)) return;
+
+    // Only the edited row and the computed cells that depend on it need redrawing
+    formulas.UpdateRow(index, row);
+    RefreshRow(index);
+    RefreshComputedCells();
 }
 
 //--------------------------------------------------
@@ -116,9 +264,18 @@ void DataTable::UpdateRow(int index, const DataRow& row) {
 //--------------------------------------------------
 void DataTable::DeleteSelectedRow() {
     int index = GetSelectedIndex();
-    if (index < 0 || index >= static_cast<int>(rows.size())) return;
+    if (index < 0) return;
+
+    if (paged) {
+        if (!paged->EraseRow(static_cast<size_t>(index))) return;
+        pagedWindow.clear();
+        RefreshList();
+        return;
+    }
 
-    rows.erase(rows.begin() + index);
+    if (!rows.Erase(static_cast<size_t>(index))) return;
+
+    formulas.EraseRow(index);
     RefreshList();
 }
 
@@ -127,9 +284,20 @@ void DataTable::DeleteSelectedRow() {
 //--------------------------------------------------
 bool DataTable::GetSelectedRow(DataRow& outRow) const {
     int index = GetSelectedIndex();
-    if (index < 0 || index >= static_cast<int>(rows.size())) return false;
+    return index >= 0 && GetRow(static_cast<size_t>(index), outRow);
+}
+
+//--------------------------------------------------
+// Get Row
+//--------------------------------------------------
+bool DataTable::GetRow(size_t index, DataRow& outRow) const {
+    if (paged)
+        return paged->GetRow(index, outRow);
+
+    VersionedRowStore::Snapshot snapshot = rows.GetSnapshot();
+    if (index >= snapshot.GetRowCount()) return false;
 
-    outRow = rows[index];
+    outRow = snapshot.GetRow(index);
     return true;
 }
 
@@ -144,7 +312,7 @@ int DataTable::GetSelectedIndex() const {
 // Get Row Count
 //--------------------------------------------------
 int DataTable::GetRowCount() const {
-    return static_cast<int>(rows.size());
+    return static_cast<int>(paged ? paged->GetRowCount() : rows.GetRowCount());
 }
 
 //--------------------------------------------------
@@ -158,24 +326,91 @@ HWND DataTable::GetHandle() const {
 // Clear Table
 //--------------------------------------------------
 void DataTable::Clear() {
-    rows.clear();
-    ListView_DeleteAllItems(hListView);
+    paged.reset();
+    pagedWindow.clear();
+    pagedWindowFirst = 0;
+
+    rows.Clear();
+    formulas.Clear();
+    RefreshList();
+}
+
+//--------------------------------------------------
+// Open Paged
+// The in-memory rows are dropped; computed columns keep
+// their definitions but get no rows, so they show empty.
+//--------------------------------------------------
+void DataTable::OpenPaged(std::unique_ptr<PagedRowStore> store) {
+    rows.Clear();
+    formulas.Clear();
+
+    paged = std::move(store);
+    pagedWindow.clear();
+    pagedWindowFirst = 0;
+    RefreshList();
+}
+
+//--------------------------------------------------
+// Is Paged / Get Paged Rows
+//--------------------------------------------------
+bool DataTable::IsPaged() const {
+    return paged != nullptr;
+}
+
+PagedRowStore* DataTable::GetPagedRows() const {
+    return paged.get();
+}
+
+//--------------------------------------------------
+// Set Schema
+// Rebuilds the ListView columns and the computed columns
+// when a sheet with different columns is loaded.
+//--------------------------------------------------
+void DataTable::SetSchema(const TableSchema& newSchema, std::wstring* outError) {
+    if (newSchema == schema) return;
+
+    schema = newSchema;
+    schema.ClearComputedColumns();
+    formulas = FormulaEngine();
+
+    for (const auto& computed : newSchema.GetComputedColumns()) {
+        std::wstring error;
+        if (formulas.AddColumn(computed.name, computed.formula, error))
+            schema.AddComputedColumn(computed.name, computed.formula);
+        else if (outError && outError->empty())
+            *outError = L"Computed column '" + computed.name + L"' was not loaded: " + error;
+    }
+    rows.SetSchema(schema);
+    if (!paged && formulas.GetColumnCount() > 0 && rows.GetRowCount() > 0)
+        formulas.SetRows(GetAllRows());
+
+    while (ListView_DeleteColumn(hListView, 0))
+        ;
+    InitializeColumns();
+    RefreshList();
+}
+
+//--------------------------------------------------
+// Get Schema
+//--------------------------------------------------
+const TableSchema& DataTable::GetSchema() const {
+    return schema;
 }
 
 //--------------------------------------------------
 // Calculate Total Cost
 //--------------------------------------------------
 double DataTable::CalculateTotalCost() const {
-    double total = 0.0;
+    if (paged)
+        return paged->CalculateTotalCost();
 
-    for (const auto& r : rows) {
-        std::wstring temp = r.cost;
-        temp.erase(std::remove(temp.begin(), temp.end(), L'$'), temp.end());
-        temp.erase(std::remove(temp.begin(), temp.end(), L','), temp.end());
+    double total = 0.0;
 
-        try {
-            total += std::stod(temp);
-        } catch (...) {}
+    VersionedRowStore::Snapshot snapshot = rows.GetSnapshot();
+    for (size_t i = 0; i < snapshot.GetRowCount(); ++i) {
+        double cost = 0.0;
+        if (CostTrackerSchema::Parse<CostTrackerColumns::Cost>(snapshot.GetRow(i), cost))
+            total += cost;
     }
     return total;
 }
@@ -183,6 +418,76 @@ double DataTable::CalculateTotalCost() const {
 //--------------------------------------------------
 // Get All Rows (Save / Load)
 //--------------------------------------------------
-const std::vector<DataRow>& DataTable::GetAllRows() const {
-    return rows;
+std::vector<DataRow> DataTable::GetAllRows() const {
+    if (!paged)
+        return rows.GetSnapshot().CopyRows();
+
+    std::vector<DataRow> all;
+    all.reserve(paged->GetRowCount());
+    paged->ForEachRow([&all](size_t, const DataRow& row) {
+        all.push_back(row);
+        return true;
+    });
+    return all;
+}
+
+//--------------------------------------------------
+// Analyze (Summary report)
+// Paged sheets stream through the store a page at a time.
+//--------------------------------------------------
+CostAnalytics::Result DataTable::Analyze(const CostAnalytics::Options& options) const {
+    if (!paged)
+        return CostAnalytics::Analyze(rows.GetSnapshot(), options);
+
+    CostAnalytics::Accumulator accumulator(options);
+    paged->ForEachRow([&accumulator](size_t index, const DataRow& row) {
+        accumulator.Add(index, row);
+        return true;
+    });
+    return accumulator.GetResult();
+}
+
+//--------------------------------------------------
+// Get Snapshot
+// Safe to read from any thread while the UI keeps editing.
+//--------------------------------------------------
+VersionedRowStore::Snapshot DataTable::GetSnapshot() const {
+    return rows.GetSnapshot();
+}
+
+//--------------------------------------------------
+// Add Computed Column
+//--------------------------------------------------
+bool DataTable::AddComputedColumn(const std::wstring& name, const std::wstring& formula, std::wstring& outError) {
+    if (paged) {
+        outError = L"Computed columns are not available for sheets opened in paged mode";
+        return false;
+    }
+    if (schema.FindColumn(name) >= 0) {
+        outError = L"A column named '" + name + L"' already exists";
+        return false;
+    }
+    if (!formulas.AddColumn(name, formula, outError))
+        return false;
+    schema.AddComputedColumn(name, formula);
+    rows.SetSchema(schema);    // readers and the next save see the new column too
+
+    int index = static_cast<int>(schema.GetColumnCount()) + formulas.GetColumnCount() - 1;
+
+    LVCOLUMNW col{};
+    col.mask = LVCF_TEXT | LVCF_WIDTH | LVCF_SUBITEM;
+    col.pszText = const_cast<LPWSTR>(name.c_str());
+    col.cx = 90;
+    col.iSubItem = index;
+    ListView_InsertColumn(hListView, index, &col);
+
+    RefreshList();
+    return true;
+}
+
+//--------------------------------------------------
+// Get Formulas
+//--------------------------------------------------
+const FormulaEngine& DataTable::GetFormulas() const {
+    return formulas;
 }
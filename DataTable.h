@@ -4,19 +4,15 @@
 #pragma once
 #include <windows.h>
 #include <commctrl.h>
+#include <memory>
 #include <string>
 #include <vector>
-
-struct DataRow {
-    std::wstring category;
-    std::wstring item;
-    std::wstring material;
-    std::wstring description;
-    std::wstring quantity;
-    std::wstring unitCost;
-    std::wstring cost;
-    std::wstring notes;
-};
+#include "CostAnalytics.h"
+#include "DataRow.h"
+#include "FormulaEngine.h"
+#include "PagedRowStore.h"
+#include "TableSchema.h"
+#include "VersionedRowStore.h"
 
 class DataTable {
 public:
@@ -24,6 +20,7 @@ public:
     ~DataTable();
 
     void AddRow(const DataRow& row);
+    void AddRows(const std::vector<DataRow>& newRows);     // one version, only new items redrawn
     void UpdateRow(int index, const DataRow& row);
     void DeleteSelectedRow();
 
@@ -31,18 +28,58 @@ public:
     int  GetSelectedIndex() const;
 
     int GetRowCount() const;
+    bool GetRow(size_t index, DataRow& outRow) const;
     double CalculateTotalCost() const;
+    CostAnalytics::Result Analyze(const CostAnalytics::Options& options) const;
+
+    // Copy of the rows (Save / Load)
+    std::vector<DataRow> GetAllRows() const;
 
-    const std::vector<DataRow>& GetAllRows() const;
+    // Stable view of the rows for background work; later edits do not affect it.
+    // Empty while a paged sheet is shown.
+    VersionedRowStore::Snapshot GetSnapshot() const;
     void Clear();
 
+    // Show a sheet too large for memory straight from a PagedRowStore; Clear returns to in-memory rows.
+    // Computed columns stay in the schema so they are saved, but they are not calculated for paged sheets.
+    void OpenPaged(std::unique_ptr<PagedRowStore> store);
+    bool IsPaged() const;
+    PagedRowStore* GetPagedRows() const;     // nullptr unless paged
+
+    // The list view is virtual (LVS_OWNERDATA): the parent forwards WM_NOTIFY here so rows are
+    // drawn on demand. Returns true if the notification was handled.
+    bool HandleNotify(const NMHDR* header);
+
+    // Columns of the sheet; extra columns (beyond the built-in ones) and computed columns come from
+    // loaded files. A computed column whose formula no longer compiles is dropped and reported in outError.
+    void SetSchema(const TableSchema& newSchema, std::wstring* outError = nullptr);
+    const TableSchema& GetSchema() const;
+
     HWND GetHandle() const;
 
+    // Computed columns (see FormulaEngine for the formula syntax); kept in the schema so they are saved
+    bool AddComputedColumn(const std::wstring& name, const std::wstring& formula, std::wstring& outError);
+    const FormulaEngine& GetFormulas() const;
+
 private:
     void InitializeColumns();
     void RefreshList();
+    void InsertItems(size_t first);
+    void RefreshRow(int index);
+    void RefreshComputedCells();
+
+    void GetItemText(LVITEMW& item);
+    const DataRow* GetPagedRow(size_t index);
+    void LoadPagedWindow(size_t first, size_t count);
 
     HWND hParent = nullptr;
     HWND hListView = nullptr;
-    std::vector<DataRow> rows;
+    VersionedRowStore rows;
+    FormulaEngine formulas;
+    TableSchema schema;
+
+    // Paged sheets: the store, and the rows around the visible part of the list
+    std::unique_ptr<PagedRowStore> paged;
+    std::vector<DataRow> pagedWindow;
+    size_t pagedWindowFirst = 0;
 };
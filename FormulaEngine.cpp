@@ -0,0 +1,790 @@
+//Implementation file for FormulaEngine class
+
+#include "FormulaEngine.h"
+#include "ImportValidator.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cwctype>
+#include <limits>
+#include <thread>
+
+namespace {
+
+// Input columns always come first: quantity, unitcost, cost
+const int kInputColumns = 3;
+const wchar_t* kInputNames[kInputColumns] = { L"quantity", L"unitcost", L"cost" };
+
+const int kMaxStack = 64;
+
+// Deepest nesting of parentheses, signs and function calls the parser follows. Formulas come
+// from file headers too, so this keeps a hostile one from exhausting the thread's stack.
+const int kMaxNesting = 256;
+
+// Work is only split across threads when there is enough of it
+const size_t kChunkRows = 4096;
+const size_t kParallelThreshold = 32768;
+
+const double kNaN = std::numeric_limits<double>::quiet_NaN();
+
+std::wstring ToLower(const std::wstring& text)
+{
+    std::wstring lower = text;
+    for (auto& ch : lower)
+        ch = static_cast<wchar_t>(std::towlower(ch));
+    return lower;
+}
+
+double ParseInput(const std::wstring& text)
+{
+    if (text.empty())
+        return 0.0;
+
+    double value = 0.0;
+    return ImportValidator::ParseNumber(text, value, true) ? value : kNaN;
+}
+
+// Error values (NaN) do not count towards totals
+double Contribution(double value)
+{
+    return std::isfinite(value) ? value : 0.0;
+}
+
+bool SameValue(double a, double b)
+{
+    return a == b || (std::isnan(a) && std::isnan(b));
+}
+
+} // namespace
+
+//--------------------------------------------------
+// Formula parser (recursive descent -> bytecode)
+//--------------------------------------------------
+class FormulaEngine::Parser {
+public:
+    Parser(const FormulaEngine& engine, const std::wstring& text)
+        : engine(engine), text(text) {}
+
+    bool Compile(Column& column, std::wstring& outError) {
+        code = &column.code;
+        deps = &column.deps;
+
+        bool ok = Expression();
+        SkipSpace();
+        if (ok && pos != text.size())
+            ok = Fail(L"Unexpected '" + std::wstring(1, text[pos]) + L"'");
+
+        if (!ok)
+            outError = error;
+        return ok;
+    }
+
+private:
+    void SkipSpace() {
+        while (pos < text.size() && std::iswspace(text[pos]))
+            pos++;
+    }
+
+    bool Match(wchar_t ch) {
+        SkipSpace();
+        if (pos < text.size() && text[pos] == ch) {
+            pos++;
+            return true;
+        }
+        return false;
+    }
+
+    bool Fail(const std::wstring& message) {
+        if (error.empty())
+            error = message;
+        return false;
+    }
+
+    bool Emit(Op op, int column = -1, double value = 0.0) {
+        static const int effect[] = {
+            1, 1, 1, 1, 1,          // Const Load Total CategoryTotal RunningTotal
+            -1, -1, -1, -1, 0, 0,   // Add Sub Mul Div Neg Abs
+            -1, -1, -1              // Round Min Max
+        };
+        depth += effect[static_cast<int>(op)];
+        if (depth > kMaxStack)
+            return Fail(L"Formula is too deeply nested");
+
+        code->push_back({ op, column, value });
+        return true;
+    }
+
+    bool Expression() {
+        if (!Term())
+            return false;
+        for (;;) {
+            if (Match(L'+')) {
+                if (!Term() || !Emit(Op::Add)) return false;
+            } else if (Match(L'-')) {
+                if (!Term() || !Emit(Op::Sub)) return false;
+            } else {
+                return true;
+            }
+        }
+    }
+
+    bool Term() {
+        if (!Unary())
+            return false;
+        for (;;) {
+            if (Match(L'*')) {
+                if (!Unary() || !Emit(Op::Mul)) return false;
+            } else if (Match(L'/')) {
+                if (!Unary() || !Emit(Op::Div)) return false;
+            } else {
+                return true;
+            }
+        }
+    }
+
+    // Every level of recursion passes through here, so nesting is counted once
+    bool Unary() {
+        if (++nesting > kMaxNesting)
+            return Fail(L"Formula is too deeply nested");
+
+        bool ok;
+        if (Match(L'-'))
+            ok = Unary() && Emit(Op::Neg);
+        else if (Match(L'+'))
+            ok = Unary();
+        else
+            ok = Primary();
+
+        nesting--;
+        return ok;
+    }
+
+    bool Identifier(std::wstring& out) {
+        SkipSpace();
+        size_t start = pos;
+        if (pos < text.size() && (std::iswalpha(text[pos]) || text[pos] == L'_')) {
+            while (pos < text.size() && (std::iswalnum(text[pos]) || text[pos] == L'_'))
+                pos++;
+        }
+        out = text.substr(start, pos - start);
+        return !out.empty();
+    }
+
+    bool ColumnArgument(DepKind kind, Op op) {
+        std::wstring name;
+        if (!Identifier(name))
+            return Fail(L"Expected a column name");
+
+        int column = engine.FindColumn(name);
+        if (column < 0)
+            return Fail(L"Unknown column '" + name + L"'");
+        if (!Match(L')'))
+            return Fail(L"Expected ')'");
+
+        deps->push_back({ column, kind });
+        return Emit(op, column);
+    }
+
+    bool Arguments(int count) {
+        for (int i = 0; i < count; i++) {
+            if (i > 0 && !Match(L','))
+                return Fail(L"Expected ','");
+            if (!Expression())
+                return false;
+        }
+        return Match(L')') || Fail(L"Expected ')'");
+    }
+
+    bool Primary() {
+        SkipSpace();
+        if (pos >= text.size())
+            return Fail(L"Unexpected end of formula");
+
+        if (Match(L'(')) {
+            if (!Expression())
+                return false;
+            return Match(L')') || Fail(L"Expected ')'");
+        }
+
+        if (std::iswdigit(text[pos]) || text[pos] == L'.') {
+            const wchar_t* start = text.c_str() + pos;
+            wchar_t* end = nullptr;
+            double value = std::wcstod(start, &end);
+            if (end == start)
+                return Fail(L"Bad number");
+            pos += static_cast<size_t>(end - start);
+            return Emit(Op::Const, -1, value);
+        }
+
+        std::wstring name;
+        if (!Identifier(name))
+            return Fail(L"Unexpected '" + std::wstring(1, text[pos]) + L"'");
+
+        if (!Match(L'(')) {
+            int column = engine.FindColumn(name);
+            if (column < 0)
+                return Fail(L"Unknown column '" + name + L"'");
+            deps->push_back({ column, DepKind::Row });
+            return Emit(Op::Load, column);
+        }
+
+        std::wstring function = ToLower(name);
+        if (function == L"sum")    return ColumnArgument(DepKind::Total, Op::Total);
+        if (function == L"catsum") return ColumnArgument(DepKind::Category, Op::CategoryTotal);
+        if (function == L"runsum") return ColumnArgument(DepKind::Running, Op::RunningTotal);
+        if (function == L"abs")    return Arguments(1) && Emit(Op::Abs);
+        if (function == L"round")  return Arguments(2) && Emit(Op::Round);
+        if (function == L"min")    return Arguments(2) && Emit(Op::Min);
+        if (function == L"max")    return Arguments(2) && Emit(Op::Max);
+
+        return Fail(L"Unknown function '" + name + L"'");
+    }
+
+    const FormulaEngine& engine;
+    const std::wstring& text;
+    size_t pos = 0;
+    int depth = 0;
+    int nesting = 0;
+    std::wstring error;
+    std::vector<Instr>* code = nullptr;
+    std::vector<Dependency>* deps = nullptr;
+};
+
+//--------------------------------------------------
+// Constructor
+//--------------------------------------------------
+FormulaEngine::FormulaEngine() {
+    columns.resize(kInputColumns);
+    for (int i = 0; i < kInputColumns; i++)
+        columns[i].name = kInputNames[i];
+}
+
+//--------------------------------------------------
+// Columns
+//--------------------------------------------------
+int FormulaEngine::FindColumn(const std::wstring& name) const {
+    std::wstring lower = ToLower(name);
+    for (size_t i = 0; i < columns.size(); i++) {
+        if (ToLower(columns[i].name) == lower)
+            return static_cast<int>(i);
+    }
+    return -1;
+}
+
+bool FormulaEngine::AddColumn(const std::wstring& name, const std::wstring& formula, std::wstring& outError) {
+    bool validName = !name.empty() && (std::iswalpha(name[0]) || name[0] == L'_');
+    for (wchar_t ch : name)
+        validName = validName && (std::iswalnum(ch) || ch == L'_');
+
+    if (!validName) {
+        outError = L"Column names may only use letters, digits and '_'";
+        return false;
+    }
+    if (FindColumn(name) >= 0) {
+        outError = L"A column named '" + name + L"' already exists";
+        return false;
+    }
+
+    Column column;
+    column.name = name;
+    column.formula = formula;
+
+    Parser parser(*this, formula);
+    if (!parser.Compile(column, outError))
+        return false;
+
+    // Formulas only see earlier columns, so definition order is a valid
+    // evaluation order and the graph can never contain a cycle
+    for (const auto& dep : column.deps) {
+        Column& source = columns[dep.column];
+        column.level = std::max(column.level, source.level + 1);
+        source.needsTotal    |= dep.kind == DepKind::Total || dep.kind == DepKind::Category;
+        source.needsCategory |= dep.kind == DepKind::Category;
+        source.needsRunning  |= dep.kind == DepKind::Running;
+    }
+    column.level = std::max(column.level, 1);
+    maxLevel = std::max(maxLevel, column.level);
+
+    columns.push_back(column);
+    RecalculateAll();
+    return true;
+}
+
+int FormulaEngine::GetColumnCount() const {
+    return static_cast<int>(columns.size()) - kInputColumns;
+}
+
+const std::wstring& FormulaEngine::GetColumnName(int column) const {
+    return columns[column + kInputColumns].name;
+}
+
+const std::wstring& FormulaEngine::GetColumnFormula(int column) const {
+    return columns[column + kInputColumns].formula;
+}
+
+void FormulaEngine::SetThreadCount(unsigned count) {
+    threadCount = count;
+}
+
+//--------------------------------------------------
+// Values
+//--------------------------------------------------
+int FormulaEngine::GetRowCount() const {
+    return static_cast<int>(categories.size());
+}
+
+double FormulaEngine::GetValue(int row, int column) const {
+    if (row < 0 || row >= GetRowCount() || column < 0 || column >= GetColumnCount())
+        return kNaN;
+    return columns[column + kInputColumns].values[row];
+}
+
+std::wstring FormulaEngine::GetText(int row, int column) const {
+    double value = GetValue(row, column);
+    if (!std::isfinite(value))
+        return L"#ERR";
+
+    // swprintf fails rather than truncating when the text does not fit
+    wchar_t buffer[kMaxTextLength + 1];
+    int length = std::swprintf(buffer, kMaxTextLength + 1, L"%.2f", value);
+    if (length < 0 || static_cast<size_t>(length) > kMaxTextLength)
+        length = std::swprintf(buffer, kMaxTextLength + 1, L"%.15g", value);
+    return length < 0 ? L"#ERR" : buffer;
+}
+
+const std::vector<FormulaEngine::Cell>& FormulaEngine::GetChangedCells() const {
+    return changedCells;
+}
+
+//--------------------------------------------------
+// Inputs
+//--------------------------------------------------
+int FormulaEngine::CategoryId(const std::wstring& category) {
+    auto it = categoryIds.find(category);
+    if (it != categoryIds.end())
+        return it->second;
+
+    int id = static_cast<int>(categoryIds.size());
+    categoryIds.emplace(category, id);
+    for (auto& column : columns) {
+        if (column.needsCategory)
+            column.categoryTotals.resize(categoryIds.size(), 0.0);
+    }
+    return id;
+}
+
+void FormulaEngine::LoadInputs(int row, const DataRow& data) {
+    columns[0].values[row] = ParseInput(data.quantity);
+    columns[1].values[row] = ParseInput(data.unitCost);
+    columns[2].values[row] = ParseInput(data.cost);
+    categories[row] = CategoryId(data.category);
+}
+
+//--------------------------------------------------
+// Bytecode interpreter
+//--------------------------------------------------
+double FormulaEngine::Evaluate(const Column& column, int row) const {
+    double stack[kMaxStack];
+    int sp = 0;
+
+    for (const Instr& in : column.code) {
+        switch (in.op) {
+            case Op::Const:         stack[sp++] = in.value; break;
+            case Op::Load:          stack[sp++] = columns[in.column].values[row]; break;
+            case Op::Total:         stack[sp++] = columns[in.column].total; break;
+            case Op::CategoryTotal: stack[sp++] = columns[in.column].categoryTotals[categories[row]]; break;
+            case Op::RunningTotal:  stack[sp++] = columns[in.column].running[row]; break;
+            case Op::Add:   sp--; stack[sp - 1] += stack[sp]; break;
+            case Op::Sub:   sp--; stack[sp - 1] -= stack[sp]; break;
+            case Op::Mul:   sp--; stack[sp - 1] *= stack[sp]; break;
+            case Op::Div:
+                sp--;
+                stack[sp - 1] = stack[sp] == 0.0 ? kNaN : stack[sp - 1] / stack[sp];
+                break;
+            case Op::Neg:   stack[sp - 1] = -stack[sp - 1]; break;
+            case Op::Abs:   stack[sp - 1] = std::fabs(stack[sp - 1]); break;
+            case Op::Round: {
+                sp--;
+                double scale = std::pow(10.0, std::floor(stack[sp]));
+                stack[sp - 1] = std::round(stack[sp - 1] * scale) / scale;
+                break;
+            }
+            case Op::Min:   sp--; stack[sp - 1] = std::min(stack[sp - 1], stack[sp]); break;
+            case Op::Max:   sp--; stack[sp - 1] = std::max(stack[sp - 1], stack[sp]); break;
+        }
+    }
+
+    double result = sp > 0 ? stack[0] : kNaN;
+    return std::isfinite(result) ? result : kNaN;
+}
+
+//--------------------------------------------------
+// Evaluate dirty rows of independent columns.
+// Columns on the same level never depend on each
+// other, so their rows are split into chunks and
+// evaluated across threads.
+//--------------------------------------------------
+void FormulaEngine::EvaluateRows(const std::vector<int>& levelColumns, const std::vector<std::vector<int>>& rows) {
+    struct Task {
+        size_t column;
+        size_t begin;
+        size_t end;
+    };
+
+    std::vector<Task> tasks;
+    size_t work = 0;
+    for (size_t c = 0; c < levelColumns.size(); c++) {
+        for (size_t begin = 0; begin < rows[c].size(); begin += kChunkRows)
+            tasks.push_back({ c, begin, std::min(begin + kChunkRows, rows[c].size()) });
+        work += rows[c].size();
+    }
+
+    auto runTask = [&](const Task& task) {
+        Column& column = columns[levelColumns[task.column]];
+        const std::vector<int>& list = rows[task.column];
+        for (size_t i = task.begin; i < task.end; i++)
+            column.values[list[i]] = Evaluate(column, list[i]);
+    };
+
+    unsigned threads = threadCount ? threadCount : std::max(1u, std::thread::hardware_concurrency());
+    threads = static_cast<unsigned>(std::min<size_t>(threads, tasks.size()));
+
+    if (threads <= 1 || work < kParallelThreshold) {
+        for (const auto& task : tasks)
+            runTask(task);
+        return;
+    }
+
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t i = next++; i < tasks.size(); i = next++)
+            runTask(tasks[i]);
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; t++)
+        pool.emplace_back(worker);
+    worker();
+    for (auto& thread : pool)
+        thread.join();
+}
+
+//--------------------------------------------------
+// Aggregates
+//--------------------------------------------------
+void FormulaEngine::RebuildRunning(Column& column, int fromRow) {
+    if (!column.needsRunning)
+        return;
+
+    size_t rowCount = column.values.size();
+    column.running.resize(rowCount);
+
+    double sum = fromRow > 0 ? column.running[fromRow - 1] : 0.0;
+    for (size_t row = static_cast<size_t>(std::max(fromRow, 0)); row < rowCount; row++) {
+        sum += Contribution(column.values[row]);
+        column.running[row] = sum;
+    }
+}
+
+void FormulaEngine::RebuildAggregates(Column& column) {
+    if (column.needsTotal) {
+        column.total = 0.0;
+        for (double value : column.values)
+            column.total += Contribution(value);
+    }
+
+    if (column.needsCategory) {
+        column.categoryTotals.assign(categoryIds.size(), 0.0);
+        for (size_t row = 0; row < column.values.size(); row++)
+            column.categoryTotals[categories[row]] += Contribution(column.values[row]);
+    }
+
+    RebuildRunning(column, 0);
+}
+
+//--------------------------------------------------
+// Full recalculation, level by level
+//--------------------------------------------------
+void FormulaEngine::RecalculateAll() {
+    size_t rowCount = categories.size();
+    for (auto& column : columns)
+        column.values.resize(rowCount, 0.0);
+
+    for (int i = 0; i < kInputColumns; i++)
+        RebuildAggregates(columns[i]);
+
+    std::vector<int> allRows(rowCount);
+    for (size_t row = 0; row < rowCount; row++)
+        allRows[row] = static_cast<int>(row);
+
+    for (int level = 1; level <= maxLevel; level++) {
+        std::vector<int> levelColumns;
+        for (size_t c = kInputColumns; c < columns.size(); c++) {
+            if (columns[c].level == level)
+                levelColumns.push_back(static_cast<int>(c));
+        }
+
+        EvaluateRows(levelColumns, std::vector<std::vector<int>>(levelColumns.size(), allRows));
+        for (int c : levelColumns)
+            RebuildAggregates(columns[c]);
+    }
+
+    changedCells.clear();
+}
+
+//--------------------------------------------------
+// Incremental recalculation after one row changed,
+// or after rows were appended from editedRow on
+// (oldCategory < 0). changed[c] lists rows whose
+// value in column c changed; it is filled in for
+// computed columns as they are evaluated, so an edit
+// that leaves a value the same stops propagating there.
+//--------------------------------------------------
+void FormulaEngine::Recalculate(std::vector<std::vector<int>>& changed, int editedRow, int oldCategory) {
+    int rowCount = GetRowCount();
+    bool categoryMoved = oldCategory >= 0 && oldCategory != categories[editedRow];
+    changedCells.clear();
+
+    for (int level = 1; level <= maxLevel; level++) {
+        std::vector<int> levelColumns;
+        std::vector<std::vector<int>> dirty;
+
+        for (size_t c = kInputColumns; c < columns.size(); c++) {
+            const Column& column = columns[c];
+            if (column.level != level)
+                continue;
+
+            // Work out which rows this column has to re-evaluate
+            bool all = false;
+            int tailFrom = rowCount;
+            std::vector<int> rows;
+            std::vector<char> dirtyCategories(categoryIds.size(), 0);
+            bool anyCategory = false;
+
+            for (const auto& dep : column.deps) {
+                const std::vector<int>& source = changed[dep.column];
+
+                if (dep.kind == DepKind::Category && categoryMoved) {
+                    dirtyCategories[oldCategory] = 1;
+                    dirtyCategories[categories[editedRow]] = 1;
+                    anyCategory = true;
+                }
+                if (source.empty())
+                    continue;
+
+                switch (dep.kind) {
+                    case DepKind::Row:
+                        rows.insert(rows.end(), source.begin(), source.end());
+                        break;
+                    case DepKind::Total:
+                        all = true;
+                        break;
+                    case DepKind::Running:
+                        tailFrom = std::min(tailFrom, source.front());
+                        break;
+                    case DepKind::Category:
+                        for (int row : source)
+                            dirtyCategories[categories[row]] = 1;
+                        anyCategory = true;
+                        break;
+                }
+            }
+
+            // Every computed cell of a new row needs a value
+            if (oldCategory < 0) {
+                for (int row = editedRow; row < rowCount; row++)
+                    rows.push_back(row);
+            }
+
+            std::vector<int> list;
+            if (all) {
+                list.resize(rowCount);
+                for (int row = 0; row < rowCount; row++)
+                    list[row] = row;
+            } else if (anyCategory || tailFrom < rowCount) {
+                std::vector<char> mark(rowCount, 0);
+                for (int row : rows)
+                    mark[row] = 1;
+                for (int row = 0; row < rowCount; row++) {
+                    if (mark[row] || row >= tailFrom || (anyCategory && dirtyCategories[categories[row]]))
+                        list.push_back(row);
+                }
+            } else {
+                std::sort(rows.begin(), rows.end());
+                rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+                list.swap(rows);
+            }
+
+            levelColumns.push_back(static_cast<int>(c));
+            dirty.push_back(std::move(list));
+        }
+
+        // Remember old values so we can tell what actually changed
+        std::vector<std::vector<double>> oldValues(levelColumns.size());
+        for (size_t i = 0; i < levelColumns.size(); i++) {
+            const Column& column = columns[levelColumns[i]];
+            for (int row : dirty[i])
+                oldValues[i].push_back(column.values[row]);
+        }
+
+        EvaluateRows(levelColumns, dirty);
+
+        for (size_t i = 0; i < levelColumns.size(); i++) {
+            int c = levelColumns[i];
+            Column& column = columns[c];
+            std::vector<int>& columnChanged = changed[c];
+
+            for (size_t k = 0; k < dirty[i].size(); k++) {
+                int row = dirty[i][k];
+                double oldValue = oldValues[i][k];
+                double newValue = column.values[row];
+                if (SameValue(oldValue, newValue))
+                    continue;
+
+                columnChanged.push_back(row);
+                changedCells.push_back({ row, c - kInputColumns });
+
+                // An edited row was detached from the aggregates up front
+                if (row == editedRow && oldCategory >= 0)
+                    continue;
+                double delta = Contribution(newValue) - Contribution(oldValue);
+                if (column.needsTotal)
+                    column.total += delta;
+                if (column.needsCategory)
+                    column.categoryTotals[categories[row]] += delta;
+            }
+
+            // Re-attach an edited row under its (possibly new) category
+            if (oldCategory >= 0) {
+                double value = Contribution(column.values[editedRow]);
+                if (column.needsTotal)
+                    column.total += value;
+                if (column.needsCategory)
+                    column.categoryTotals[categories[editedRow]] += value;
+            }
+
+            if (!columnChanged.empty())
+                RebuildRunning(column, columnChanged.front());
+        }
+    }
+}
+
+//--------------------------------------------------
+// Row changes
+//--------------------------------------------------
+void FormulaEngine::SetRows(const std::vector<DataRow>& rows) {
+    categories.assign(rows.size(), 0);
+    for (auto& column : columns)
+        column.values.assign(rows.size(), 0.0);
+
+    for (size_t row = 0; row < rows.size(); row++)
+        LoadInputs(static_cast<int>(row), rows[row]);
+
+    RecalculateAll();
+}
+
+void FormulaEngine::AppendRow(const DataRow& row) {
+    AppendRows(std::vector<DataRow>(1, row));
+}
+
+//--------------------------------------------------
+// Append a block of rows. The columns are extended
+// once and each dirty cell is evaluated once, so a
+// column with totals costs one pass per block rather
+// than one per row.
+//--------------------------------------------------
+void FormulaEngine::AppendRows(const std::vector<DataRow>& rows) {
+    if (rows.empty())
+        return;
+
+    int first = GetRowCount();
+    int rowCount = first + static_cast<int>(rows.size());
+    categories.resize(rowCount, 0);
+    for (auto& column : columns) {
+        column.values.resize(rowCount, 0.0);
+        if (column.needsRunning)
+            column.running.resize(rowCount, column.running.empty() ? 0.0 : column.running.back());
+    }
+
+    for (int row = first; row < rowCount; row++)
+        LoadInputs(row, rows[row - first]);
+
+    std::vector<std::vector<int>> changed(columns.size());
+    for (int c = 0; c < kInputColumns; c++) {
+        Column& column = columns[c];
+        for (int row = first; row < rowCount; row++) {
+            double value = Contribution(column.values[row]);
+            if (column.needsTotal)
+                column.total += value;
+            if (column.needsCategory)
+                column.categoryTotals[categories[row]] += value;
+            changed[c].push_back(row);
+        }
+        RebuildRunning(column, first);
+    }
+
+    Recalculate(changed, first, -1);
+}
+
+void FormulaEngine::UpdateRow(int index, const DataRow& row) {
+    if (index < 0 || index >= GetRowCount())
+        return;
+
+    // Detach the row from every aggregate; it is added back with its new values
+    int oldCategory = categories[index];
+    for (auto& column : columns) {
+        double value = Contribution(column.values[index]);
+        if (column.needsTotal)
+            column.total -= value;
+        if (column.needsCategory)
+            column.categoryTotals[oldCategory] -= value;
+    }
+
+    double oldInputs[kInputColumns];
+    for (int c = 0; c < kInputColumns; c++)
+        oldInputs[c] = columns[c].values[index];
+
+    LoadInputs(index, row);
+
+    std::vector<std::vector<int>> changed(columns.size());
+    for (int c = 0; c < kInputColumns; c++) {
+        Column& column = columns[c];
+        double value = Contribution(column.values[index]);
+        if (column.needsTotal)
+            column.total += value;
+        if (column.needsCategory)
+            column.categoryTotals[categories[index]] += value;
+
+        if (!SameValue(oldInputs[c], column.values[index])) {
+            changed[c].push_back(index);
+            RebuildRunning(column, index);
+        }
+    }
+
+    Recalculate(changed, index, oldCategory);
+}
+
+void FormulaEngine::EraseRow(int index) {
+    if (index < 0 || index >= GetRowCount())
+        return;
+
+    // Deleting shifts every row after it, so recalculate from scratch
+    categories.erase(categories.begin() + index);
+    for (auto& column : columns)
+        column.values.erase(column.values.begin() + index);
+
+    RecalculateAll();
+}
+
+void FormulaEngine::Clear() {
+    categories.clear();
+    categoryIds.clear();
+    for (auto& column : columns) {
+        column.values.clear();
+        column.categoryTotals.clear();
+        column.running.clear();
+        column.total = 0.0;
+    }
+    changedCells.clear();
+}
@@ -0,0 +1,119 @@
+//Header for the FormulaEngine class. The purpose of the class is to keep computed columns (tax, markup,
+//per-category share, running totals...) up to date as rows are added and edited. Formulas are compiled to a
+//small bytecode once, and an edit only recalculates the cells that depend on what actually changed.
+//
+//Formula syntax:
+//  numbers, + - * / and parentheses
+//  quantity, unitcost, cost          values from the row (currency symbols are ignored)
+//  <name>                            an earlier computed column on the same row
+//  SUM(col)                          column total over all rows
+//  CATSUM(col)                       column total over rows in the same category
+//  RUNSUM(col)                       running total from the first row to this one
+//  ABS(x)  ROUND(x, digits)  MIN(a, b)  MAX(a, b)
+//
+//Example: AddColumn(L"Tax", L"cost * 0.07"), AddColumn(L"Share", L"cost / CATSUM(cost)")
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "DataRow.h"
+
+class FormulaEngine {
+public:
+    struct Cell {
+        int row;
+        int column;     // computed column index (0 = first computed column)
+    };
+
+    FormulaEngine();
+
+    // Add a computed column. Formulas may only refer to input columns and columns added before them.
+    bool AddColumn(const std::wstring& name, const std::wstring& formula, std::wstring& outError);
+
+    int GetColumnCount() const;
+    const std::wstring& GetColumnName(int column) const;
+    const std::wstring& GetColumnFormula(int column) const;
+
+    // Keep the engine's inputs in step with the table
+    void SetRows(const std::vector<DataRow>& rows);     // full recalculation
+    void AppendRow(const DataRow& row);
+    void AppendRows(const std::vector<DataRow>& rows);  // one recalculation for the whole block
+    void UpdateRow(int index, const DataRow& row);      // recalculates dirty cells only
+    void EraseRow(int index);
+    void Clear();
+
+    // Computed cells whose value changed in the last AppendRow(s) / UpdateRow
+    const std::vector<Cell>& GetChangedCells() const;
+
+    int GetRowCount() const;
+    double GetValue(int row, int column) const;
+    std::wstring GetText(int row, int column) const;   // at most kMaxTextLength characters
+
+    // Two decimals, or %.15g for values too large for that
+    static constexpr size_t kMaxTextLength = 32;
+
+    // 0 = use all hardware threads
+    void SetThreadCount(unsigned count);
+
+private:
+    enum class Op : uint8_t {
+        Const, Load, Total, CategoryTotal, RunningTotal,
+        Add, Sub, Mul, Div, Neg, Abs, Round, Min, Max
+    };
+
+    struct Instr {
+        Op op;
+        int column;
+        double value;
+    };
+
+    enum class DepKind : uint8_t { Row, Total, Category, Running };
+
+    struct Dependency {
+        int column;
+        DepKind kind;
+    };
+
+    struct Column {
+        std::wstring name;
+        std::wstring formula;
+        std::vector<Instr> code;
+        std::vector<Dependency> deps;
+        int level = 0;
+
+        // Aggregates kept only for columns some formula aggregates over
+        bool needsTotal = false;
+        bool needsCategory = false;
+        bool needsRunning = false;
+        double total = 0.0;
+        std::vector<double> categoryTotals;
+        std::vector<double> running;
+
+        std::vector<double> values;
+    };
+
+    class Parser;
+
+    int FindColumn(const std::wstring& name) const;
+    int CategoryId(const std::wstring& category);
+    void LoadInputs(int row, const DataRow& data);
+    double Evaluate(const Column& column, int row) const;
+
+    void EvaluateRows(const std::vector<int>& columns, const std::vector<std::vector<int>>& rows);
+    void RebuildAggregates(Column& column);
+    void RebuildRunning(Column& column, int fromRow);
+    void RecalculateAll();
+    void Recalculate(std::vector<std::vector<int>>& changed, int editedRow, int oldCategory);
+
+    std::vector<Column> columns;        // inputs first, then computed columns
+    int maxLevel = 0;
+
+    std::vector<int> categories;        // category id per row
+    std::unordered_map<std::wstring, int> categoryIds;
+
+    std::vector<Cell> changedCells;
+    unsigned threadCount = 0;
+};
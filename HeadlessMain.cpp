@@ -0,0 +1,459 @@
+//Entry point for the headless build: serves a cost sheet to local tools over QueryServer, and includes a load
+//generator that measures the server's throughput and latency. Build without the Win32 sources, e.g.
+//  g++ -std=c++17 -O2 -pthread HeadlessMain.cpp QueryServer.cpp CsvFollower.cpp CostAnalytics.cpp ImportValidator.cpp
+//      SpreadsheetStorage.cpp PagedRowStore.cpp FormulaEngine.cpp TableSchema.cpp VersionedRowStore.cpp ZipArchive.cpp
+//      AtomicFile.cpp -o costsheet
+//
+//  costsheet serve <file.csv|file.xlsx> [--port N | --socket PATH] [--workers N] [--follow]
+//  costsheet loadgen [--port N | --socket PATH] [--clients N] [--requests N] [--pipeline N] [--batch N]
+//                    [--mix summary,groupby,filter,rows,ping]
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <thread>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "CsvFollower.h"
+#include "ImportValidator.h"
+#include "QueryServer.h"
+#include "SpreadsheetStorage.h"
+#include "TextEncoding.h"
+#include "VersionedRowStore.h"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct LoadOptions {
+    std::string socketPath;
+    unsigned short port = 7411;
+    unsigned clients = 4;
+    size_t requests = 100000;       // in total, across clients
+    size_t pipeline = 16;           // messages in flight per client
+    size_t batch = 1;               // requests per message (BATCH k when above 1)
+    std::vector<std::string> mix{ "summary", "groupby", "filter", "rows" };
+};
+
+struct ClientResult {
+    std::vector<double> latencies;  // microseconds per message
+    size_t errors = 0;
+    bool failed = false;
+};
+
+void PrintUsage()
+{
+    std::fprintf(stderr,
+        "usage:\n"
+        "  costsheet serve <file.csv|file.xlsx> [--port N | --socket PATH] [--workers N] [--follow]\n"
+        "  costsheet loadgen [--port N | --socket PATH] [--clients N] [--requests N] [--pipeline N]\n"
+        "                    [--batch N] [--mix summary,groupby,filter,rows,ping]\n");
+}
+
+bool IsXlsxPath(const std::string& path)
+{
+    if (path.size() < 5)
+        return false;
+    std::string ext = path.substr(path.size() - 5);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext == ".xlsx";
+}
+
+bool ParseNumberArg(const char* text, size_t& out)
+{
+    char* end = nullptr;
+    unsigned long long value = std::strtoull(text, &end, 10);
+    if (end == text || *end != '\0')
+        return false;
+    out = static_cast<size_t>(value);
+    return true;
+}
+
+std::vector<std::string> SplitList(const std::string& text)
+{
+    std::vector<std::string> items;
+    size_t start = 0;
+    while (start <= text.size()) {
+        size_t comma = text.find(',', start);
+        if (comma == std::string::npos)
+            comma = text.size();
+        if (comma > start)
+            items.push_back(text.substr(start, comma - start));
+        start = comma + 1;
+    }
+    return items;
+}
+
+int Connect(const std::string& socketPath, unsigned short port)
+{
+    int fd;
+    if (!socketPath.empty()) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (socketPath.size() >= sizeof(address.sun_path))
+            return -1;
+        std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    } else {
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+            close(fd);
+            fd = -1;
+        }
+        if (fd >= 0) {
+            int on = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        }
+    }
+    return fd;
+}
+
+bool SendAll(int fd, const std::string& data)
+{
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0)
+            return false;
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Buffered line reader over a blocking socket
+class LineReader {
+public:
+    explicit LineReader(int fd) : fd(fd) {}
+
+    bool ReadLine(std::string& line) {
+        for (;;) {
+            size_t newline = buffer.find('\n', start);
+            if (newline != std::string::npos) {
+                line.assign(buffer, start, newline - start);
+                start = newline + 1;
+                if (start == buffer.size()) {
+                    buffer.clear();
+                    start = 0;
+                }
+                return true;
+            }
+            if (start > 0) {
+                buffer.erase(0, start);
+                start = 0;
+            }
+            char chunk[64 * 1024];
+            ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+            if (n <= 0)
+                return false;
+            buffer.append(chunk, static_cast<size_t>(n));
+        }
+    }
+
+    // One response: "OK <n> ..." and n lines, or "ERR ..."
+    bool ReadResponse(bool& isError, std::string* firstLine = nullptr) {
+        std::string line;
+        if (!ReadLine(line))
+            return false;
+        isError = line.compare(0, 3, "OK ") != 0;
+        if (isError)
+            return true;
+
+        size_t count = std::strtoull(line.c_str() + 3, nullptr, 10);
+        for (size_t i = 0; i < count; i++) {
+            std::string body;
+            if (!ReadLine(body))
+                return false;
+            if (firstLine && i == 0)
+                *firstLine = body;
+        }
+        return true;
+    }
+
+private:
+    int fd;
+    std::string buffer;
+    size_t start = 0;
+};
+
+std::string RequestFor(const std::string& kind, size_t rowCount, std::mt19937& random)
+{
+    if (kind == "summary")
+        return "SUMMARY";
+    if (kind == "groupby")
+        return "GROUPBY Category";
+    if (kind == "filter")
+        return "FILTER Cost > 1000 10";
+    if (kind == "rows") {
+        size_t first = rowCount > 20 ? random() % (rowCount - 20) : 0;
+        return "ROWS " + std::to_string(first) + " 20";
+    }
+    return "PING";
+}
+
+void RunClient(const LoadOptions& options, size_t messages, size_t rowCount, unsigned seed, ClientResult& result)
+{
+    int fd = Connect(options.socketPath, options.port);
+    if (fd < 0) {
+        result.failed = true;
+        return;
+    }
+
+    LineReader reader(fd);
+    std::mt19937 random(seed);
+    std::deque<Clock::time_point> inFlight;
+    size_t sent = 0, received = 0, next = seed;
+    result.latencies.reserve(messages);
+
+    std::string out;
+    while (received < messages) {
+        // Top the pipeline up with one write
+        out.clear();
+        while (sent < messages && inFlight.size() < options.pipeline) {
+            if (options.batch > 1)
+                out += "BATCH " + std::to_string(options.batch) + "\n";
+            for (size_t i = 0; i < options.batch; i++) {
+                out += RequestFor(options.mix[next++ % options.mix.size()], rowCount, random);
+                out += '\n';
+            }
+            inFlight.push_back(Clock::now());
+            sent++;
+        }
+        if (!out.empty() && !SendAll(fd, out)) {
+            result.failed = true;
+            break;
+        }
+
+        bool ok = true;
+        for (size_t i = 0; i < options.batch && ok; i++) {
+            bool isError = false;
+            ok = reader.ReadResponse(isError);
+            if (isError)
+                result.errors++;
+        }
+        if (!ok) {
+            result.failed = true;
+            break;
+        }
+
+        auto elapsed = Clock::now() - inFlight.front();
+        inFlight.pop_front();
+        result.latencies.push_back(std::chrono::duration<double, std::micro>(elapsed).count());
+        received++;
+    }
+    close(fd);
+}
+
+double Percentile(const std::vector<double>& sorted, double q)
+{
+    if (sorted.empty())
+        return 0.0;
+    size_t index = static_cast<size_t>(q * static_cast<double>(sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+int RunLoadGenerator(const LoadOptions& options)
+{
+    // Row count for ROWS requests
+    size_t rowCount = 0;
+    {
+        int fd = Connect(options.socketPath, options.port);
+        if (fd < 0) {
+            std::fprintf(stderr, "Cannot connect to the server.\n");
+            return 1;
+        }
+        LineReader reader(fd);
+        bool isError = false;
+        std::string summary;
+        if (SendAll(fd, "SUMMARY\n") && reader.ReadResponse(isError, &summary) && !isError)
+            rowCount = std::strtoull(summary.c_str(), nullptr, 10);
+        close(fd);
+    }
+
+    size_t clients = std::max(1u, options.clients);
+    size_t messages = std::max<size_t>(1, options.requests / options.batch);
+    std::vector<ClientResult> results(clients);
+    std::vector<std::thread> threads;
+
+    Clock::time_point begin = Clock::now();
+    for (size_t c = 0; c < clients; c++) {
+        size_t share = messages / clients + (c < messages % clients ? 1 : 0);
+        threads.emplace_back(RunClient, std::cref(options), share, rowCount, static_cast<unsigned>(c + 1),
+            std::ref(results[c]));
+    }
+    for (auto& thread : threads)
+        thread.join();
+    double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+
+    std::vector<double> latencies;
+    size_t errors = 0, failedClients = 0;
+    for (const auto& result : results) {
+        latencies.insert(latencies.end(), result.latencies.begin(), result.latencies.end());
+        errors += result.errors;
+        failedClients += result.failed ? 1 : 0;
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    size_t requests = latencies.size() * options.batch;
+    std::printf("clients %zu, pipeline %zu, batch %zu, %zu rows\n", clients, options.pipeline, options.batch, rowCount);
+    std::printf("%zu requests in %.2f s: %.0f requests/s, %zu errors, %zu clients failed\n",
+        requests, seconds, seconds > 0 ? static_cast<double>(requests) / seconds : 0.0, errors, failedClients);
+    std::printf("latency per message (us): p50 %.0f  p90 %.0f  p99 %.0f  p99.9 %.0f  max %.0f\n",
+        Percentile(latencies, 0.50), Percentile(latencies, 0.90), Percentile(latencies, 0.99),
+        Percentile(latencies, 0.999), latencies.empty() ? 0.0 : latencies.back());
+    return failedClients == 0 ? 0 : 1;
+}
+
+int RunServer(const std::string& path, const QueryServer::Options& options, bool follow)
+{
+    // Signals are taken with sigwait below, so block them before any thread starts
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    std::wstring filePath = Utf8ToWide(path);
+    std::vector<DataRow> rows;
+    std::vector<size_t> lineNumbers;
+    TableSchema schema;
+    std::vector<ImportIssue> issues;
+
+    bool loaded = IsXlsxPath(path)
+        ? SpreadsheetStorage::LoadFromXLSX(filePath, rows, &schema)
+        : SpreadsheetStorage::LoadFromCSV(filePath, rows, &lineNumbers, &schema, &issues);
+    if (!loaded) {
+        std::fprintf(stderr, "Cannot read %s\n", path.c_str());
+        return 1;
+    }
+
+    ImportValidator::ValidateAndNormalize(rows, lineNumbers, schema, issues);
+    if (!issues.empty())
+        std::fprintf(stderr, "%zu problem(s) found while loading (first on line %zu)\n",
+            issues.size(), issues[0].line);
+
+    VersionedRowStore store;
+    store.Replace(rows, schema);
+    size_t rowCount = rows.size();
+    rows.clear();
+    rows.shrink_to_fit();
+
+    QueryServer server(store);
+    if (!server.Start(options)) {
+        std::fprintf(stderr, "Cannot listen on %s\n",
+            options.socketPath.empty() ? ("port " + std::to_string(options.port)).c_str() : options.socketPath.c_str());
+        return 1;
+    }
+
+    // Keep the shared table in step with a file another program appends to
+    CsvFollower follower;
+    if (follow) {
+        follower.Start(filePath, [&store](CsvFollower::Batch&& batch) {
+            ImportValidator::ValidateAndNormalize(batch.rows, batch.lineNumbers, batch.schema, batch.issues);
+            // A reload publishes its rows and columns as one version, so no query sees them apart
+            if (batch.reload)
+                store.Replace(batch.rows, batch.schema);
+            else
+                store.Append(batch.rows);
+        });
+    }
+
+    if (options.socketPath.empty())
+        std::printf("Serving %zu rows on 127.0.0.1:%u\n", rowCount, server.GetPort());
+    else
+        std::printf("Serving %zu rows on %s\n", rowCount, options.socketPath.c_str());
+    std::fflush(stdout);
+
+    int signal = 0;
+    sigwait(&signals, &signal);
+
+    follower.Stop();
+    server.Stop();
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        PrintUsage();
+        return 1;
+    }
+
+    std::string mode = argv[1];
+    QueryServer::Options serverOptions;
+    LoadOptions loadOptions;
+    std::string file;
+    bool follow = false;
+
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        size_t number = 0;
+
+        if (arg == "--socket" && hasValue) {
+            serverOptions.socketPath = loadOptions.socketPath = argv[++i];
+        } else if (arg == "--port" && hasValue && ParseNumberArg(argv[++i], number) && number <= 65535) {
+            serverOptions.port = loadOptions.port = static_cast<unsigned short>(number);
+        } else if (arg == "--workers" && hasValue && ParseNumberArg(argv[++i], number)) {
+            serverOptions.workerCount = static_cast<unsigned>(number);
+        } else if (arg == "--follow") {
+            follow = true;
+        } else if (arg == "--clients" && hasValue && ParseNumberArg(argv[++i], number) && number > 0) {
+            loadOptions.clients = static_cast<unsigned>(number);
+        } else if (arg == "--requests" && hasValue && ParseNumberArg(argv[++i], number) && number > 0) {
+            loadOptions.requests = number;
+        } else if (arg == "--pipeline" && hasValue && ParseNumberArg(argv[++i], number) && number > 0) {
+            loadOptions.pipeline = number;
+        } else if (arg == "--batch" && hasValue && ParseNumberArg(argv[++i], number) && number > 0) {
+            loadOptions.batch = number;
+        } else if (arg == "--mix" && hasValue) {
+            loadOptions.mix = SplitList(argv[++i]);
+        } else if (mode == "serve" && file.empty() && arg.compare(0, 2, "--") != 0) {
+            file = arg;
+        } else {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    if (mode == "serve" && !file.empty())
+        return RunServer(file, serverOptions, follow);
+    if (mode == "loadgen" && !loadOptions.mix.empty())
+        return RunLoadGenerator(loadOptions);
+
+    PrintUsage();
+    return 1;
+}
+
+#else
+
+int main()
+{
+    std::fprintf(stderr, "The headless server needs Linux (its event loop uses epoll).\n");
+    return 1;
+}
+
+#endif
@@ -0,0 +1,400 @@
+//Implementation file for ImportValidator class
+
+#include "ImportValidator.h"
+#include "TableSchema.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cwchar>
+#include <thread>
+
+namespace {
+
+// Rows per chunk handed to a worker thread
+const size_t kChunkRows = 16384;
+
+// A cost is accepted if it is within half a cent of quantity x unit cost
+const double kCostTolerance = 0.005;
+
+// Largest amount formatted to the cent. Below it the cent count is exact in a double
+// (under 2^53); far above it llround would overflow a long long.
+const double kMaxMoney = 1e13;
+
+// An amount is kept to the decimal places it was typed with while its scaled value stays
+// below this (exact in a double, like whole cents below kMaxMoney); further places are
+// more than a double holds anyway.
+const double kMaxScaledMoney = 1e15;
+const int kMaxMoneyPlaces = 15;
+
+const double kPowersOfTen[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+bool IsSpace(wchar_t ch)
+{
+    return ch == L' ' || ch == L'\t' || ch == L'\r' || ch == L'\n' || ch == L'\xA0';
+}
+
+bool IsDigit(wchar_t ch)
+{
+    return ch >= L'0' && ch <= L'9';
+}
+
+// Trim in place; returns true if anything was removed
+bool Trim(std::wstring& text)
+{
+    size_t begin = 0, end = text.size();
+    while (begin < end && IsSpace(text[begin]))
+        begin++;
+    while (end > begin && IsSpace(text[end - 1]))
+        end--;
+
+    if (begin == 0 && end == text.size())
+        return false;
+    text.erase(end);
+    text.erase(0, begin);
+    return true;
+}
+
+bool IsMoneyInRange(double value)
+{
+    return std::fabs(value) < kMaxMoney;
+}
+
+// Decimal places written in a number's text (digits after the point, less any exponent)
+int DecimalPlaces(const std::wstring& text)
+{
+    long places = 0;
+    size_t point = text.find(L'.');
+    if (point != std::wstring::npos) {
+        for (size_t i = point + 1; i < text.size() && IsDigit(text[i]); i++)
+            places++;
+    }
+
+    size_t exponent = text.find_first_of(L"eE");
+    if (exponent != std::wstring::npos)
+        places -= std::max(-1000L, std::min(1000L, std::wcstol(text.c_str() + exponent + 1, nullptr, 10)));
+    return static_cast<int>(std::max(0L, std::min(places, static_cast<long>(kMaxMoneyPlaces))));
+}
+
+// Format into the end of a caller's buffer and return the start of the text.
+// At least two decimal places are written; more are kept when places asks for them.
+const wchar_t* FormatMoneyTo(wchar_t* bufferEnd, size_t bufferSize, double value, int places = 2)
+{
+    // Out of range (or not a number): plain decimal form instead of whole cents
+    if (!IsMoneyInRange(value)) {
+        wchar_t* start = bufferEnd - bufferSize;
+        std::swprintf(start, bufferSize, value < 0 ? L"-$%.15g" : L"$%.15g", std::fabs(value));
+        return start;
+    }
+
+    places = std::max(places, 2);
+    while (places > 2 && std::fabs(value) * kPowersOfTen[places] >= kMaxScaledMoney)
+        places--;
+
+    long long scaled = std::llround(value * kPowersOfTen[places]);
+    bool negative = scaled < 0;
+    unsigned long long magnitude = negative ? 0ull - static_cast<unsigned long long>(scaled)
+                                            : static_cast<unsigned long long>(scaled);
+
+    wchar_t* p = bufferEnd;
+    *--p = L'\0';
+    for (int i = 0; i < places; i++) {
+        *--p = static_cast<wchar_t>(L'0' + magnitude % 10);
+        magnitude /= 10;
+    }
+    *--p = L'.';
+    do {
+        *--p = static_cast<wchar_t>(L'0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude > 0);
+    *--p = L'$';
+    if (negative)
+        *--p = L'-';
+    return p;
+}
+
+const wchar_t* FormatQuantityTo(wchar_t* bufferEnd, size_t bufferSize, double value)
+{
+    // Whole numbers are by far the common case
+    if (value == std::floor(value) && std::fabs(value) < 1e15) {
+        long long whole = static_cast<long long>(value);
+        bool negative = whole < 0;
+        unsigned long long magnitude = negative ? 0ull - static_cast<unsigned long long>(whole)
+                                                : static_cast<unsigned long long>(whole);
+        wchar_t* p = bufferEnd;
+        *--p = L'\0';
+        do {
+            *--p = static_cast<wchar_t>(L'0' + magnitude % 10);
+            magnitude /= 10;
+        } while (magnitude > 0);
+        if (negative)
+            *--p = L'-';
+        return p;
+    }
+
+    wchar_t* start = bufferEnd - bufferSize;
+    std::swprintf(start, bufferSize, L"%.15g", value);
+    return start;
+}
+
+// Assign only when the text differs, so already-clean rows cost no allocations
+void SetIfDifferent(std::wstring& field, const wchar_t* value)
+{
+    if (field.compare(value) != 0)
+        field.assign(value);
+}
+
+} // namespace
+
+//--------------------------------------------------
+// Parse Number
+// Digits are accumulated into an integer mantissa; when
+// it and the decimal exponent are small enough the result
+// is exact with one multiply or divide. Anything else
+// falls back to strtod on a narrow copy.
+//--------------------------------------------------
+bool ImportValidator::ParseNumber(const wchar_t* begin, const wchar_t* end, double& out, bool allowCurrency) {
+    while (begin < end && IsSpace(*begin))
+        begin++;
+    while (end > begin && IsSpace(end[-1]))
+        end--;
+
+    const wchar_t* p = begin;
+    bool negative = false;
+    bool sawSign = false;
+
+    // Sign and currency symbol may come in either order: -$5 or $-5
+    if (p < end && (*p == L'-' || *p == L'+')) {
+        negative = *p == L'-';
+        sawSign = true;
+        p++;
+    }
+    if (allowCurrency && p < end && *p == L'$') {
+        p++;
+        if (!sawSign && p < end && (*p == L'-' || *p == L'+')) {
+            negative = *p == L'-';
+            p++;
+        }
+    }
+
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool anyDigits = false;
+    bool exact = true;
+
+    // Integer part (commas allowed between digits for currency)
+    for (; p < end; p++) {
+        if (IsDigit(*p)) {
+            anyDigits = true;
+            if (digits < 19) {
+                mantissa = mantissa * 10 + static_cast<uint64_t>(*p - L'0');
+                if (mantissa != 0)
+                    digits++;
+            } else {
+                exponent++;
+                exact = false;
+            }
+        } else if (allowCurrency && *p == L',' && anyDigits && p + 1 < end && IsDigit(p[1])) {
+            continue;
+        } else {
+            break;
+        }
+    }
+
+    // Fraction
+    if (p < end && *p == L'.') {
+        p++;
+        for (; p < end && IsDigit(*p); p++) {
+            anyDigits = true;
+            if (digits < 19) {
+                mantissa = mantissa * 10 + static_cast<uint64_t>(*p - L'0');
+                if (mantissa != 0)
+                    digits++;
+                exponent--;
+            } else {
+                exact = false;
+            }
+        }
+    }
+
+    if (!anyDigits)
+        return false;
+
+    // Exponent
+    if (p < end && (*p == L'e' || *p == L'E')) {
+        p++;
+        bool negativeExp = false;
+        if (p < end && (*p == L'-' || *p == L'+')) {
+            negativeExp = *p == L'-';
+            p++;
+        }
+        if (p == end || !IsDigit(*p))
+            return false;
+
+        int value = 0;
+        for (; p < end && IsDigit(*p); p++) {
+            if (value < 100000)
+                value = value * 10 + (*p - L'0');
+        }
+        exponent += negativeExp ? -value : value;
+    }
+
+    if (p != end)
+        return false;
+
+    double result;
+    if (exact && mantissa < (1ull << 53) && exponent >= -22 && exponent <= 22) {
+        result = static_cast<double>(mantissa);
+        result = exponent < 0 ? result / kPowersOfTen[-exponent] : result * kPowersOfTen[exponent];
+    } else {
+        // Rare: very long or very large numbers
+        std::string narrow;
+        narrow.reserve(static_cast<size_t>(end - begin));
+        for (const wchar_t* q = begin; q < end; q++) {
+            if (IsDigit(*q) || *q == L'.' || *q == L'e' || *q == L'E' || *q == L'-' || *q == L'+')
+                narrow += static_cast<char>(*q);
+        }
+        if (!narrow.empty() && (narrow[0] == '-' || narrow[0] == '+'))
+            narrow.erase(0, 1);
+        result = std::strtod(narrow.c_str(), nullptr);
+    }
+
+    if (!std::isfinite(result))
+        return false;
+
+    out = negative ? -result : result;
+    return true;
+}
+
+bool ImportValidator::ParseNumber(const std::wstring& text, double& out, bool allowCurrency) {
+    return ParseNumber(text.data(), text.data() + text.size(), out, allowCurrency);
+}
+
+//--------------------------------------------------
+// Format Money
+//--------------------------------------------------
+std::wstring ImportValidator::FormatMoney(double value) {
+    wchar_t buffer[32];
+    return FormatMoneyTo(buffer + 32, 32, value);
+}
+
+//--------------------------------------------------
+// Validate one chunk of rows
+//--------------------------------------------------
+void ImportValidator::ValidateRange(
+    std::vector<DataRow>& rows,
+    const std::vector<size_t>& lineNumbers,
+    const TableSchema& schema,
+    size_t begin,
+    size_t end,
+    std::vector<ImportIssue>& outIssues
+)
+{
+    const size_t columnCount = schema.GetColumnCount();
+    const size_t quantityColumn = CostTrackerColumns::Quantity;
+    const size_t unitCostColumn = CostTrackerColumns::UnitCost;
+    const size_t costColumn = CostTrackerColumns::Cost;
+
+    // Sheets without their own cost columns have nothing to cross-check
+    const bool checkCost = schema.GetColumn(quantityColumn).required && schema.GetColumn(unitCostColumn).required
+        && schema.GetColumn(costColumn).required;
+
+    for (size_t i = begin; i < end; i++) {
+        DataRow& row = rows[i];
+        size_t line = i < lineNumbers.size() ? lineNumbers[i] : i + 2;
+
+        wchar_t buffer[32];
+        double quantity = 0.0, unitCost = 0.0, cost = 0.0;
+        bool costValid = checkCost;
+
+        for (size_t column = 0; column < columnCount; column++) {
+            const ColumnInfo& info = schema.GetColumn(column);
+            std::wstring& field = schema.GetField(row, column);
+            if (info.type == ColumnType::Text) {
+                Trim(field);
+                continue;
+            }
+
+            bool money = info.type == ColumnType::Money;
+            double value = 0.0;
+            bool parsed = ParseNumber(field, value, money);
+            bool inRange = parsed && (!money || IsMoneyInRange(value));
+
+            if (inRange) {
+                // Money keeps the places it was given (a unit cost of $0.125 stays exact)
+                SetIfDifferent(field, money ? FormatMoneyTo(buffer + 32, 32, value, DecimalPlaces(field))
+                                            : FormatQuantityTo(buffer + 32, 32, value));
+            } else {
+                Trim(field);
+                int issueColumn = static_cast<int>(column);
+                if (parsed)
+                    outIssues.push_back({ line, issueColumn, info.name + L" '" + field + L"' is out of range" });
+                else if (!field.empty())
+                    outIssues.push_back({ line, issueColumn, info.name + L" '" + field + L"' is not a number" });
+                else if (info.required)
+                    outIssues.push_back({ line, issueColumn, info.name + L" is missing" });
+            }
+
+            if (column == quantityColumn)
+                quantity = value;
+            else if (column == unitCostColumn)
+                unitCost = value;
+            else if (column == costColumn)
+                cost = value;
+            if (column >= quantityColumn && column <= costColumn)
+                costValid = costValid && inRange;
+        }
+
+        if (costValid) {
+            double expected = quantity * unitCost;
+            if (std::fabs(cost - expected) > kCostTolerance + 1e-9 * std::fabs(expected)) {
+                outIssues.push_back({ line, static_cast<int>(costColumn), L"Cost " + row.cost
+                    + L" does not match quantity x unit cost (" + FormatMoney(expected) + L")" });
+            }
+        }
+    }
+}
+
+//--------------------------------------------------
+// Validate and Normalize (parallel over chunks)
+//--------------------------------------------------
+void ImportValidator::ValidateAndNormalize(
+    std::vector<DataRow>& rows,
+    const std::vector<size_t>& lineNumbers,
+    const TableSchema& schema,
+    std::vector<ImportIssue>& outIssues,
+    unsigned threadCount
+)
+{
+    size_t chunks = (rows.size() + kChunkRows - 1) / kChunkRows;
+    unsigned threads = threadCount ? threadCount : std::max(1u, std::thread::hardware_concurrency());
+    threads = static_cast<unsigned>(std::min<size_t>(threads, chunks));
+
+    if (threads <= 1) {
+        ValidateRange(rows, lineNumbers, schema, 0, rows.size(), outIssues);
+        return;
+    }
+
+    // Each chunk keeps its own issue list so the report stays in file order
+    std::vector<std::vector<ImportIssue>> chunkIssues(chunks);
+    std::vector<std::thread> pool;
+
+    for (unsigned t = 0; t < threads; t++) {
+        pool.emplace_back([&, t]() {
+            for (size_t c = t; c < chunks; c += threads) {
+                size_t begin = c * kChunkRows;
+                size_t end = std::min(begin + kChunkRows, rows.size());
+                ValidateRange(rows, lineNumbers, schema, begin, end, chunkIssues[c]);
+            }
+        });
+    }
+    for (auto& thread : pool)
+        thread.join();
+
+    for (auto& issues : chunkIssues)
+        outIssues.insert(outIssues.end(), issues.begin(), issues.end());
+}
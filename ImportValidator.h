@@ -0,0 +1,55 @@
+//Header for the ImportValidator class. The purpose of the class is to check and tidy rows read from a file
+//before they reach the table: numbers are parsed without exceptions, whitespace and currency formatting are
+//normalised, and cost is checked against quantity x unit cost. What each column holds comes from the sheet's
+//schema. Problems are reported per line and column.
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "DataRow.h"
+
+class TableSchema;
+
+struct ImportIssue {
+    size_t line;            // line (or sheet row) the value came from
+    int column;             // schema column: 0 = Category ... 7 = Notes, then extra columns (-1 = none)
+    std::wstring message;
+};
+
+class ImportValidator {
+public:
+    // Parse a number without exceptions or locale lookups. Surrounding whitespace is ignored.
+    // With allowCurrency a '$' sign and ',' thousands separators are accepted as well.
+    static bool ParseNumber(const std::wstring& text, double& out, bool allowCurrency = false);
+    static bool ParseNumber(const wchar_t* begin, const wchar_t* end, double& out, bool allowCurrency);
+
+    // "$1234.50" style text used for unit cost and cost. Amounts of 1e13 or more (and non-finite
+    // values) cannot be held as whole cents and are written in plain decimal form, e.g. "$1.5e+20".
+    static std::wstring FormatMoney(double value);
+
+    // Normalise every row in place and add its problems to outIssues (problems already there, e.g.
+    // from reading the file, are kept). lineNumbers gives the source line of each
+    // row (empty = row i came from line i + 2, after the header). Text columns are trimmed and Number
+    // and Money columns normalised ("$1,234.5 " becomes "$1234.50"; amounts keep any further decimal
+    // places they were given); an empty value is only reported in a required column, and cost
+    // is only checked against quantity x unit cost when all three are required (i.e. in the file).
+    // The work is split across threads.
+    static void ValidateAndNormalize(
+        std::vector<DataRow>& rows,
+        const std::vector<size_t>& lineNumbers,
+        const TableSchema& schema,
+        std::vector<ImportIssue>& outIssues,
+        unsigned threadCount = 0
+    );
+
+private:
+    static void ValidateRange(
+        std::vector<DataRow>& rows,
+        const std::vector<size_t>& lineNumbers,
+        const TableSchema& schema,
+        size_t begin,
+        size_t end,
+        std::vector<ImportIssue>& outIssues
+    );
+};
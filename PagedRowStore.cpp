@@ -0,0 +1,581 @@
+//Implementation file for PagedRowStore class
+//
+//Page layout: [row count : u32][used bytes : u32] then each row as
+//[extra column count : u32] and the eight built-in fields followed by the
+//extra ones, each as [byte length : u32][UTF-8 bytes], in TableSchema order.
+
+#include "PagedRowStore.h"
+#include "TableSchema.h"
+#include "TextEncoding.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+const size_t kPageHeader = 8;
+const uint32_t kFieldCount = static_cast<uint32_t>(CostTrackerSchema::kColumnCount);
+
+uint32_t ReadU32(const char* p)
+{
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+void WriteU32(char* p, uint32_t v)
+{
+    std::memcpy(p, &v, sizeof(v));
+}
+
+void AppendU32(std::string& out, uint32_t v)
+{
+    char bytes[4];
+    WriteU32(bytes, v);
+    out.append(bytes, 4);
+}
+
+void AppendField(std::string& out, const std::wstring& field)
+{
+    size_t lengthPos = out.size();
+    AppendU32(out, 0);
+    AppendUtf8(out, field);
+    WriteU32(&out[lengthPos], static_cast<uint32_t>(out.size() - lengthPos - 4));
+}
+
+const char* ReadField(const char* p, std::wstring& field)
+{
+    uint32_t length = ReadU32(p);
+    field.clear();
+    AppendWide(field, p + 4, length);
+    return p + 4 + length;
+}
+
+void RemoveFile(const std::wstring& path)
+{
+#ifdef _WIN32
+    _wremove(path.c_str());
+#else
+    std::remove(WideToUtf8(path).c_str());
+#endif
+}
+
+} // namespace
+
+//--------------------------------------------------
+// Constructor / Destructor
+//--------------------------------------------------
+PagedRowStore::PagedRowStore() {}
+
+PagedRowStore::~PagedRowStore() {
+    Close();
+}
+
+//--------------------------------------------------
+// Open / Close
+//--------------------------------------------------
+bool PagedRowStore::Open(const std::wstring& backingFile) {
+    return Open(backingFile, Options());
+}
+
+bool PagedRowStore::Open(const std::wstring& backingFile, const Options& newOptions) {
+    Close();
+
+    options = newOptions;
+    options.pageSize = std::max<size_t>(options.pageSize, 4096);
+    path = backingFile;
+
+    OpenFileStream(file, path, std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    OpenFileStream(prefetchFile, path, std::ios::in | std::ios::binary);
+    if (!prefetchFile.is_open()) {
+        file.close();
+        RemoveFile(path);
+        return false;
+    }
+
+    isOpen = true;
+    stopPrefetch = false;
+    prefetchThread = std::thread(&PagedRowStore::PrefetchLoop, this);
+    return true;
+}
+
+void PagedRowStore::Close() {
+    if (!isOpen)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopPrefetch = true;
+        prefetchQueue.clear();
+    }
+    prefetchWake.notify_all();
+    if (prefetchThread.joinable())
+        prefetchThread.join();
+
+    file.close();
+    prefetchFile.close();
+    RemoveFile(path);
+
+    pages.clear();
+    firstRows.clear();
+    cache.clear();
+    lruOrder.clear();
+    slotVersions.clear();
+    rowCount = 0;
+    nextSlot = 0;
+    lastPageRead = SIZE_MAX;
+    isOpen = false;
+}
+
+//--------------------------------------------------
+// Page directory
+//--------------------------------------------------
+size_t PagedRowStore::FindPage(size_t row) const {
+    auto it = std::upper_bound(firstRows.begin(), firstRows.end(), row);
+    return static_cast<size_t>(it - firstRows.begin()) - 1;
+}
+
+void PagedRowStore::RebuildFirstRows(size_t fromPage) {
+    firstRows.resize(pages.size());
+    size_t first = fromPage == 0 ? 0 : firstRows[fromPage - 1] + pages[fromPage - 1].rowCount;
+    for (size_t p = fromPage; p < pages.size(); p++) {
+        firstRows[p] = first;
+        first += pages[p].rowCount;
+    }
+}
+
+//--------------------------------------------------
+// Page cache (LRU, bounded by options.memoryLimit)
+//--------------------------------------------------
+void PagedRowStore::Touch(CachedPage& page, uint64_t slot) {
+    lruOrder.erase(page.lru);
+    lruOrder.push_front(slot);
+    page.lru = lruOrder.begin();
+}
+
+void PagedRowStore::InsertPage(uint64_t slot, std::vector<char>&& data) {
+    CachedPage& page = cache[slot];
+    page.data = std::move(data);
+    page.dirty = false;
+
+    uint32_t count = ReadU32(page.data.data());
+    page.offsets.clear();
+    page.offsets.reserve(count);
+
+    size_t pos = kPageHeader;
+    for (uint32_t r = 0; r < count; r++) {
+        page.offsets.push_back(static_cast<uint32_t>(pos));
+        uint32_t fields = kFieldCount + ReadU32(page.data.data() + pos);
+        pos += 4;
+        for (uint32_t f = 0; f < fields; f++)
+            pos += 4 + ReadU32(page.data.data() + pos);
+    }
+
+    lruOrder.push_front(slot);
+    page.lru = lruOrder.begin();
+}
+
+bool PagedRowStore::EvictIfNeeded() {
+    size_t maxPages = std::max<size_t>(2, options.memoryLimit / options.pageSize);
+    bool ok = true;
+
+    while (cache.size() > maxPages) {
+        uint64_t victim = lruOrder.back();
+        CachedPage& page = cache[victim];
+        if (page.dirty)
+            ok = WritePage(victim, page) && ok;
+        lruOrder.pop_back();
+        cache.erase(victim);
+    }
+    return ok;
+}
+
+bool PagedRowStore::WritePage(uint64_t slot, CachedPage& page) {
+    file.seekp(static_cast<std::streamoff>(slot * options.pageSize));
+    file.write(page.data.data(), static_cast<std::streamsize>(options.pageSize));
+    file.flush();
+    slotVersions[slot]++;
+    page.dirty = false;
+    return static_cast<bool>(file);
+}
+
+bool PagedRowStore::ReadPage(std::ifstream& stream, uint64_t slot, std::vector<char>& data) const {
+    data.resize(options.pageSize);
+    stream.clear();
+    stream.seekg(static_cast<std::streamoff>(slot * options.pageSize));
+    stream.read(data.data(), static_cast<std::streamsize>(options.pageSize));
+    return static_cast<bool>(stream);
+}
+
+PagedRowStore::CachedPage* PagedRowStore::LoadPage(uint64_t slot) {
+    auto it = cache.find(slot);
+    if (it != cache.end()) {
+        Touch(it->second, slot);
+        return &it->second;
+    }
+
+    std::vector<char> data;
+    file.clear();
+    file.seekg(static_cast<std::streamoff>(slot * options.pageSize));
+    data.resize(options.pageSize);
+    file.read(data.data(), static_cast<std::streamsize>(options.pageSize));
+    if (!file)
+        return nullptr;
+
+    InsertPage(slot, std::move(data));
+    EvictIfNeeded();
+    return &cache[slot];
+}
+
+//--------------------------------------------------
+// Row encoding
+//--------------------------------------------------
+void PagedRowStore::EncodeRow(const DataRow& row, std::string& out) const {
+    AppendU32(out, static_cast<uint32_t>(row.extra.size()));
+    CostTrackerSchema::ForEach(row, [&out](size_t, const std::wstring& field) {
+        AppendField(out, field);
+    });
+    for (const std::wstring& field : row.extra)
+        AppendField(out, field);
+}
+
+void PagedRowStore::DecodeRow(const CachedPage& page, size_t index, DataRow& out) const {
+    const char* p = page.data.data() + page.offsets[index];
+    out.extra.resize(ReadU32(p));
+    p += 4;
+
+    CostTrackerSchema::ForEach(out, [&p](size_t, std::wstring& field) {
+        p = ReadField(p, field);
+    });
+    for (std::wstring& field : out.extra)
+        p = ReadField(p, field);
+}
+
+//--------------------------------------------------
+// Prefetch
+//--------------------------------------------------
+void PagedRowStore::RequestPrefetch(size_t pageIndex) {
+    bool sequential = lastPageRead != SIZE_MAX && pageIndex == lastPageRead + 1;
+    lastPageRead = pageIndex;
+    if (!sequential || options.prefetchPages == 0)
+        return;
+
+    size_t maxPages = std::max<size_t>(2, options.memoryLimit / options.pageSize);
+    size_t ahead = std::min(options.prefetchPages, maxPages / 2);
+
+    bool queued = false;
+    for (size_t p = pageIndex + 1; p <= pageIndex + ahead && p < pages.size(); p++) {
+        if (!cache.count(pages[p].slot)) {
+            prefetchQueue.push_back(pages[p].slot);
+            queued = true;
+        }
+    }
+    if (queued)
+        prefetchWake.notify_one();
+}
+
+void PagedRowStore::PrefetchLoop() {
+    std::vector<char> data;
+    std::unique_lock<std::mutex> lock(mutex);
+
+    for (;;) {
+        prefetchWake.wait(lock, [this]() { return stopPrefetch || !prefetchQueue.empty(); });
+        if (stopPrefetch)
+            return;
+
+        uint64_t slot = prefetchQueue.front();
+        prefetchQueue.pop_front();
+        if (cache.count(slot))
+            continue;
+
+        // Read without holding the lock; if the page is written back meanwhile, drop what we read
+        uint64_t version = slotVersions[slot];
+        lock.unlock();
+        bool ok = ReadPage(prefetchFile, slot, data);
+        lock.lock();
+
+        // Readers only use a page while holding the lock, so evicting here is safe.
+        // Read-ahead is capped at half the cache, so the page being read stays resident.
+        if (ok && !stopPrefetch && !cache.count(slot) && slotVersions[slot] == version) {
+            InsertPage(slot, std::move(data));
+            EvictIfNeeded();
+        }
+        data.clear();
+    }
+}
+
+//--------------------------------------------------
+// Append Row
+//--------------------------------------------------
+bool PagedRowStore::AppendRow(const DataRow& row) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!isOpen)
+        return false;
+
+    std::string encoded;
+    EncodeRow(row, encoded);
+    if (encoded.size() > options.pageSize - kPageHeader)
+        return false;   // a single row must fit in one page
+
+    CachedPage* page = pages.empty() ? nullptr : LoadPage(pages.back().slot);
+    uint32_t used = page ? ReadU32(page->data.data() + 4) : 0;
+
+    if (!page || used + encoded.size() > options.pageSize) {
+        uint64_t slot = nextSlot++;
+        std::vector<char> data(options.pageSize, 0);
+        WriteU32(data.data() + 4, static_cast<uint32_t>(kPageHeader));
+        InsertPage(slot, std::move(data));
+
+        pages.push_back({ slot, 0 });
+        firstRows.push_back(rowCount);
+
+        page = &cache[slot];
+        page->dirty = true;
+        used = static_cast<uint32_t>(kPageHeader);
+    }
+
+    std::memcpy(page->data.data() + used, encoded.data(), encoded.size());
+    page->offsets.push_back(used);
+    WriteU32(page->data.data(), static_cast<uint32_t>(page->offsets.size()));
+    WriteU32(page->data.data() + 4, used + static_cast<uint32_t>(encoded.size()));
+    page->dirty = true;
+
+    pages.back().rowCount++;
+    rowCount++;
+    return EvictIfNeeded();
+}
+
+//--------------------------------------------------
+// Update Row
+//--------------------------------------------------
+bool PagedRowStore::RewritePage(size_t pageIndex, const std::vector<DataRow>& rows) {
+    // Pack rows into as many pages as needed; the first reuses the old slot
+    std::vector<std::vector<char>> packed;
+    std::vector<uint32_t> counts;
+    std::string encoded;
+
+    for (const auto& row : rows) {
+        encoded.clear();
+        EncodeRow(row, encoded);
+        if (encoded.size() > options.pageSize - kPageHeader)
+            return false;
+
+        if (packed.empty() || ReadU32(packed.back().data() + 4) + encoded.size() > options.pageSize) {
+            packed.emplace_back(options.pageSize, 0);
+            WriteU32(packed.back().data() + 4, static_cast<uint32_t>(kPageHeader));
+            counts.push_back(0);
+        }
+
+        std::vector<char>& data = packed.back();
+        uint32_t used = ReadU32(data.data() + 4);
+        std::memcpy(data.data() + used, encoded.data(), encoded.size());
+        WriteU32(data.data() + 4, used + static_cast<uint32_t>(encoded.size()));
+        WriteU32(data.data(), ++counts.back());
+    }
+
+    std::vector<PageInfo> added;
+    for (size_t i = 0; i < packed.size(); i++) {
+        uint64_t slot = i == 0 ? pages[pageIndex].slot : nextSlot++;
+        if (i == 0) {
+            lruOrder.erase(cache[slot].lru);
+            cache.erase(slot);
+        } else {
+            added.push_back({ slot, counts[i] });
+        }
+        InsertPage(slot, std::move(packed[i]));
+        cache[slot].dirty = true;
+    }
+
+    pages[pageIndex].rowCount = counts[0];
+    pages.insert(pages.begin() + pageIndex + 1, added.begin(), added.end());
+    if (!added.empty())
+        RebuildFirstRows(pageIndex);
+
+    return EvictIfNeeded();
+}
+
+bool PagedRowStore::UpdateRow(size_t index, const DataRow& row) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!isOpen || index >= rowCount)
+        return false;
+
+    size_t pageIndex = FindPage(index);
+    CachedPage* page = LoadPage(pages[pageIndex].slot);
+    if (!page)
+        return false;
+
+    std::vector<DataRow> rows(page->offsets.size());
+    for (size_t r = 0; r < rows.size(); r++)
+        DecodeRow(*page, r, rows[r]);
+    rows[index - firstRows[pageIndex]] = row;
+
+    return RewritePage(pageIndex, rows);
+}
+
+//--------------------------------------------------
+// Erase Row
+// The page is rewritten without the row; a page left empty
+// is dropped from the directory and its slot is not reused.
+//--------------------------------------------------
+bool PagedRowStore::EraseRow(size_t index) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!isOpen || index >= rowCount)
+        return false;
+
+    size_t pageIndex = FindPage(index);
+    uint64_t slot = pages[pageIndex].slot;
+    CachedPage* page = LoadPage(slot);
+    if (!page)
+        return false;
+
+    std::vector<DataRow> rows(page->offsets.size());
+    for (size_t r = 0; r < rows.size(); r++)
+        DecodeRow(*page, r, rows[r]);
+    rows.erase(rows.begin() + (index - firstRows[pageIndex]));
+
+    bool ok = true;
+    if (rows.empty()) {
+        lruOrder.erase(page->lru);
+        cache.erase(slot);
+        pages.erase(pages.begin() + pageIndex);
+    } else {
+        ok = RewritePage(pageIndex, rows);
+    }
+
+    rowCount--;
+    lastPageRead = SIZE_MAX;
+    RebuildFirstRows(pageIndex);
+    return ok;
+}
+
+//--------------------------------------------------
+// Flush dirty pages to the backing file
+//--------------------------------------------------
+bool PagedRowStore::Flush() {
+    std::lock_guard<std::mutex> lock(mutex);
+    bool ok = true;
+    for (auto& entry : cache) {
+        if (entry.second.dirty)
+            ok = WritePage(entry.first, entry.second) && ok;
+    }
+    return ok;
+}
+
+//--------------------------------------------------
+// Reads
+//--------------------------------------------------
+size_t PagedRowStore::GetRowCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return rowCount;
+}
+
+bool PagedRowStore::GetRow(size_t index, DataRow& outRow) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!isOpen || index >= rowCount)
+        return false;
+
+    size_t pageIndex = FindPage(index);
+    CachedPage* page = LoadPage(pages[pageIndex].slot);
+    if (!page)
+        return false;
+
+    RequestPrefetch(pageIndex);
+    DecodeRow(*page, index - firstRows[pageIndex], outRow);
+    return true;
+}
+
+size_t PagedRowStore::GetRows(size_t offset, size_t count, std::vector<DataRow>& outRows) {
+    std::lock_guard<std::mutex> lock(mutex);
+    outRows.clear();
+    if (!isOpen || offset >= rowCount)
+        return 0;
+
+    count = std::min(count, rowCount - offset);
+    outRows.resize(count);
+
+    size_t copied = 0;
+    size_t pageIndex = FindPage(offset);
+    while (copied < count && pageIndex < pages.size()) {
+        CachedPage* page = LoadPage(pages[pageIndex].slot);
+        if (!page)
+            break;
+        RequestPrefetch(pageIndex);
+
+        size_t first = offset + copied - firstRows[pageIndex];
+        for (size_t r = first; r < page->offsets.size() && copied < count; r++)
+            DecodeRow(*page, r, outRows[copied++]);
+        pageIndex++;
+    }
+
+    outRows.resize(copied);
+    return copied;
+}
+
+bool PagedRowStore::ForEachRow(const std::function<bool(size_t index, const DataRow& row)>& visit) {
+    std::vector<DataRow> rows;
+    size_t pageCount;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!isOpen)
+            return false;
+        pageCount = pages.size();
+    }
+
+    // Decode one page under the lock, then visit its rows without holding it
+    for (size_t pageIndex = 0; pageIndex < pageCount; pageIndex++) {
+        size_t first;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (pageIndex >= pages.size())
+                break;
+            CachedPage* page = LoadPage(pages[pageIndex].slot);
+            if (!page)
+                return false;
+            RequestPrefetch(pageIndex);
+
+            rows.resize(page->offsets.size());
+            for (size_t r = 0; r < rows.size(); r++)
+                DecodeRow(*page, r, rows[r]);
+            first = firstRows[pageIndex];
+            pageCount = pages.size();
+        }
+
+        for (size_t r = 0; r < rows.size(); r++) {
+            if (!visit(first + r, rows[r]))
+                return true;
+        }
+    }
+    return true;
+}
+
+double PagedRowStore::CalculateTotalCost() {
+    double total = 0.0;
+    ForEachRow([&total](size_t, const DataRow& row) {
+        double cost = 0.0;
+        if (CostTrackerSchema::Parse<CostTrackerColumns::Cost>(row, cost))
+            total += cost;
+        return true;
+    });
+    return total;
+}
+
+std::vector<size_t> PagedRowStore::Filter(const std::function<bool(const DataRow& row)>& predicate) {
+    std::vector<size_t> matches;
+    ForEachRow([&](size_t index, const DataRow& row) {
+        if (predicate(row))
+            matches.push_back(index);
+        return true;
+    });
+    return matches;
+}
+
+size_t PagedRowStore::GetResidentBytes() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t bytes = 0;
+    for (const auto& entry : cache)
+        bytes += entry.second.data.capacity() + entry.second.offsets.capacity() * sizeof(uint32_t);
+    return bytes;
+}
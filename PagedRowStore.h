@@ -0,0 +1,107 @@
+//Header for the PagedRowStore class. The purpose of the class is to hold sheets that are bigger than memory.
+//Rows live in a backing file split into fixed-size pages; only a bounded LRU cache of pages is kept in memory.
+//Sequential reads prefetch the next pages on a background thread, GetRows serves the visible window of a
+//virtual list view, and aggregates and filters stream through the pages one at a time.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "DataRow.h"
+
+class PagedRowStore {
+public:
+    struct Options {
+        size_t pageSize = 64 * 1024;            // bytes per page on disk and in the cache
+        size_t memoryLimit = 64 * 1024 * 1024;  // cap on cached page bytes
+        size_t prefetchPages = 4;               // pages read ahead on sequential access
+    };
+
+    PagedRowStore();
+    ~PagedRowStore();
+
+    // Create (or truncate) the backing file. The file is removed again by Close.
+    bool Open(const std::wstring& backingFile, const Options& options);
+    bool Open(const std::wstring& backingFile);
+    void Close();
+
+    bool AppendRow(const DataRow& row);
+    bool UpdateRow(size_t index, const DataRow& row);
+    bool EraseRow(size_t index);
+    bool Flush();
+
+    size_t GetRowCount() const;
+    bool GetRow(size_t index, DataRow& outRow);
+
+    // Copy rows [offset, offset + count) into outRows; returns how many were copied
+    size_t GetRows(size_t offset, size_t count, std::vector<DataRow>& outRows);
+
+    // Visit rows in order, one page at a time. Return false from the callback to stop.
+    bool ForEachRow(const std::function<bool(size_t index, const DataRow& row)>& visit);
+
+    double CalculateTotalCost();
+    std::vector<size_t> Filter(const std::function<bool(const DataRow& row)>& predicate);
+
+    size_t GetResidentBytes() const;
+
+private:
+    struct PageInfo {
+        uint64_t slot;          // position of the page in the file, in pages
+        uint32_t rowCount;
+    };
+
+    struct CachedPage {
+        std::vector<char> data;
+        std::vector<uint32_t> offsets;  // start of each row within data
+        bool dirty = false;
+        std::list<uint64_t>::iterator lru;
+    };
+
+    size_t FindPage(size_t row) const;
+    void RebuildFirstRows(size_t fromPage);
+
+    CachedPage* LoadPage(uint64_t slot);
+    void InsertPage(uint64_t slot, std::vector<char>&& data);
+    void Touch(CachedPage& page, uint64_t slot);
+    bool EvictIfNeeded();
+    bool WritePage(uint64_t slot, CachedPage& page);
+    bool ReadPage(std::ifstream& stream, uint64_t slot, std::vector<char>& data) const;
+
+    void EncodeRow(const DataRow& row, std::string& out) const;
+    void DecodeRow(const CachedPage& page, size_t index, DataRow& out) const;
+    bool RewritePage(size_t pageIndex, const std::vector<DataRow>& rows);
+
+    void RequestPrefetch(size_t pageIndex);
+    void PrefetchLoop();
+
+    Options options;
+    std::wstring path;
+    std::fstream file;
+    std::ifstream prefetchFile;
+    bool isOpen = false;
+
+    std::vector<PageInfo> pages;        // logical order
+    std::vector<size_t> firstRows;      // first row index of each page
+    size_t rowCount = 0;
+    uint64_t nextSlot = 0;
+
+    std::unordered_map<uint64_t, CachedPage> cache;
+    std::list<uint64_t> lruOrder;       // most recent first
+    std::unordered_map<uint64_t, uint64_t> slotVersions;
+    size_t lastPageRead = SIZE_MAX;
+
+    mutable std::mutex mutex;
+    std::condition_variable prefetchWake;
+    std::deque<uint64_t> prefetchQueue;
+    std::thread prefetchThread;
+    bool stopPrefetch = false;
+};
@@ -0,0 +1,920 @@
+//Implementation file for QueryServer class
+
+#include "QueryServer.h"
+#include "CostAnalytics.h"
+#include "ImportValidator.h"
+#include "TextEncoding.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cwchar>
+#include <cwctype>
+#include <map>
+
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <cerrno>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// epoll ids; clients are numbered from kFirstClientId
+const uint64_t kListenId = 0;
+const uint64_t kWakeId = 1;
+const uint64_t kFirstClientId = 2;
+
+const size_t kReadBlock = 64 * 1024;
+const size_t kMaxLine = 64 * 1024;                  // a longer request line closes the connection
+const size_t kMaxPendingInput = 1024 * 1024;        // stop reading a client until its requests are answered
+const size_t kMaxPendingOutput = 4 * 1024 * 1024;   // stop answering a client that is not reading
+const size_t kMaxBatch = 10000;
+const size_t kDefaultFilterLimit = 100;
+const size_t kMaxResultRows = 10000;
+
+// Cache key of SUMMARY; GROUPBY uses its column index
+const size_t kSummaryKey = SIZE_MAX;
+
+enum class FilterOp { Equal, NotEqual, Contains, Less, LessEqual, Greater, GreaterEqual };
+
+// Split a request into arguments: spaces separate, "double quotes" group ("" is a literal quote)
+std::vector<std::wstring> Tokenize(const std::string& line)
+{
+    std::wstring text = Utf8ToWide(line);
+    std::vector<std::wstring> args;
+    std::wstring current;
+    bool inQuotes = false;
+    bool hasToken = false;
+
+    for (size_t i = 0; i < text.size(); i++) {
+        wchar_t ch = text[i];
+        if (ch == L'"') {
+            if (inQuotes && i + 1 < text.size() && text[i + 1] == L'"') {
+                current += L'"';
+                i++;
+            } else {
+                inQuotes = !inQuotes;
+            }
+            hasToken = true;
+        } else if (!inQuotes && (ch == L' ' || ch == L'\t')) {
+            if (hasToken)
+                args.push_back(std::move(current));
+            current.clear();
+            hasToken = false;
+        } else {
+            current += ch;
+            hasToken = true;
+        }
+    }
+    if (hasToken)
+        args.push_back(std::move(current));
+    return args;
+}
+
+std::wstring ToUpper(std::wstring text)
+{
+    for (auto& ch : text)
+        ch = static_cast<wchar_t>(std::towupper(ch));
+    return text;
+}
+
+std::wstring ToLower(std::wstring text)
+{
+    for (auto& ch : text)
+        ch = static_cast<wchar_t>(std::towlower(ch));
+    return text;
+}
+
+bool ParseCount(const std::wstring& text, size_t& out)
+{
+    if (text.empty() || text[0] < L'0' || text[0] > L'9')
+        return false;
+    wchar_t* end = nullptr;
+    unsigned long long value = std::wcstoull(text.c_str(), &end, 10);
+    if (*end != L'\0')
+        return false;
+    out = static_cast<size_t>(value);
+    return true;
+}
+
+// "BATCH <k>" as seen by the event loop, before the line is tokenized
+bool IsBatchLine(const char* begin, const char* end, size_t& outCount)
+{
+    while (begin < end && (*begin == ' ' || *begin == '\t'))
+        begin++;
+    if (end - begin < 6)
+        return false;
+
+    const char* word = "BATCH";
+    for (int i = 0; i < 5; i++) {
+        if (std::toupper(static_cast<unsigned char>(begin[i])) != word[i])
+            return false;
+    }
+    if (begin[5] != ' ' && begin[5] != '\t')
+        return false;
+
+    std::string count(begin + 6, end);
+    char* parsed = nullptr;
+    unsigned long long value = std::strtoull(count.c_str(), &parsed, 10);
+    while (*parsed == ' ' || *parsed == '\t' || *parsed == '\r')
+        parsed++;
+    if (parsed == count.c_str() || *parsed != '\0' || value > kMaxBatch)
+        return false;
+    outCount = static_cast<size_t>(value);
+    return true;
+}
+
+void AppendFormat(std::string& out, const char* format, double value)
+{
+    char buffer[64];
+    std::snprintf(buffer, sizeof(buffer), format, value);
+    out += buffer;
+}
+
+// Responses are line-framed, so fields must not carry line breaks (XLSX cells can)
+void FlattenLineBreaks(std::string& out, size_t from, bool tabsToo)
+{
+    for (size_t i = from; i < out.size(); i++) {
+        if (out[i] == '\n' || out[i] == '\r' || (tabsToo && out[i] == '\t'))
+            out[i] = ' ';
+    }
+}
+
+void AppendTextField(std::string& out, const std::wstring& text)
+{
+    size_t start = out.size();
+    AppendUtf8(out, text);
+    FlattenLineBreaks(out, start, true);
+}
+
+void AppendCsvRow(std::string& out, size_t index, const DataRow& row, const TableSchema& schema)
+{
+    out += std::to_string(index);
+    out += '\t';
+
+    size_t extraCount = schema.GetExtraCount();
+    size_t bound = CostTrackerSchema::CsvBound(row) + extraCount * 3;
+    for (size_t e = 0; e < extraCount && e < row.extra.size(); e++)
+        bound += CsvFieldBound(row.extra[e]);
+
+    size_t start = out.size();
+    out.resize(start + bound);
+    char* p = CostTrackerSchema::EncodeCsv(&out[start], row);
+    for (size_t e = 0; e < extraCount; e++) {
+        *p++ = ',';
+        if (e < row.extra.size())
+            p = PutCsvField(p, row.extra[e]);
+    }
+    out.resize(static_cast<size_t>(p - out.data()));
+    FlattenLineBreaks(out, start, false);
+    out += '\n';
+}
+
+void AppendError(std::string& out, const std::string& message)
+{
+    out += "ERR ";
+    out += message;
+    out += '\n';
+}
+
+bool ParseOp(const std::wstring& text, FilterOp& out)
+{
+    if (text == L"=" || text == L"==") out = FilterOp::Equal;
+    else if (text == L"!=")            out = FilterOp::NotEqual;
+    else if (text == L"~")             out = FilterOp::Contains;
+    else if (text == L"<")             out = FilterOp::Less;
+    else if (text == L"<=")            out = FilterOp::LessEqual;
+    else if (text == L">")             out = FilterOp::Greater;
+    else if (text == L">=")            out = FilterOp::GreaterEqual;
+    else return false;
+    return true;
+}
+
+// Numeric columns compare as numbers when the value is a number; text compares exactly
+// (= and !=) or case-insensitively (~)
+struct FilterTest {
+    FilterOp op;
+    std::wstring value;         // lower-cased for ~
+    bool numeric = false;
+    double number = 0.0;
+
+    bool Matches(const std::wstring& field) const {
+        if (op == FilterOp::Contains)
+            return ToLower(field).find(value) != std::wstring::npos;
+
+        if (!numeric) {
+            bool equal = field == value;
+            if (op == FilterOp::Equal)    return equal;
+            if (op == FilterOp::NotEqual) return !equal;
+            int order = field.compare(value);
+            switch (op) {
+                case FilterOp::Less:      return order < 0;
+                case FilterOp::LessEqual: return order <= 0;
+                case FilterOp::Greater:   return order > 0;
+                default:                  return order >= 0;
+            }
+        }
+
+        double fieldNumber = 0.0;
+        if (!ImportValidator::ParseNumber(field, fieldNumber, true))
+            return op == FilterOp::NotEqual;
+        switch (op) {
+            case FilterOp::Equal:     return fieldNumber == number;
+            case FilterOp::NotEqual:  return fieldNumber != number;
+            case FilterOp::Less:      return fieldNumber < number;
+            case FilterOp::LessEqual: return fieldNumber <= number;
+            case FilterOp::Greater:   return fieldNumber > number;
+            default:                  return fieldNumber >= number;
+        }
+    }
+};
+
+bool FindColumn(const TableSchema& schema, const std::wstring& name, size_t& out, std::string& response)
+{
+    int column = schema.FindColumn(name);
+    if (column < 0) {
+        AppendError(response, "unknown column '" + WideToUtf8(name) + "'");
+        return false;
+    }
+    out = static_cast<size_t>(column);
+    return true;
+}
+
+void RunSummary(const VersionedRowStore::Snapshot& rows, std::string& out)
+{
+    TDigest digest;
+    double total = 0.0;
+    for (size_t i = 0; i < rows.GetRowCount(); i++) {
+        double cost = 0.0;
+        if (CostTrackerSchema::Parse<CostTrackerColumns::Cost>(rows.GetRow(i), cost)) {
+            total += cost;
+            digest.Add(cost);
+        }
+    }
+
+    out += "OK 1\n";
+    out += std::to_string(rows.GetRowCount());
+    AppendFormat(out, "\t%.2f", total);
+    if (digest.GetCount() > 0) {
+        AppendFormat(out, "\t%.2f", digest.GetQuantile(0.5));
+        AppendFormat(out, "\t%.2f", digest.GetQuantile(0.95));
+    } else {
+        out += "\t-\t-";
+    }
+    out += '\n';
+}
+
+void RunGroupBy(const VersionedRowStore::Snapshot& rows, const TableSchema& schema, size_t column, std::string& out)
+{
+    struct Group {
+        size_t rows = 0;
+        double total = 0.0;
+    };
+    std::map<std::wstring, Group> groups;
+
+    for (size_t i = 0; i < rows.GetRowCount(); i++) {
+        const DataRow& row = rows.GetRow(i);
+        Group& group = groups[schema.GetField(row, column)];
+        group.rows++;
+        double cost = 0.0;
+        if (CostTrackerSchema::Parse<CostTrackerColumns::Cost>(row, cost))
+            group.total += cost;
+    }
+
+    out += "OK " + std::to_string(groups.size()) + "\n";
+    for (const auto& entry : groups) {
+        AppendTextField(out, entry.first);
+        out += '\t';
+        out += std::to_string(entry.second.rows);
+        AppendFormat(out, "\t%.2f\n", entry.second.total);
+    }
+}
+
+void RunFilter(const VersionedRowStore::Snapshot& rows, const TableSchema& schema, size_t column,
+               const FilterTest& test, size_t limit, std::string& out)
+{
+    std::string body;
+    size_t matches = 0;
+    for (size_t i = 0; i < rows.GetRowCount(); i++) {
+        const DataRow& row = rows.GetRow(i);
+        if (!test.Matches(schema.GetField(row, column)))
+            continue;
+        if (matches < limit)
+            AppendCsvRow(body, i, row, schema);
+        matches++;
+    }
+
+    out += "OK " + std::to_string(std::min(matches, limit)) + " " + std::to_string(matches) + "\n";
+    out += body;
+}
+
+void RunRows(const VersionedRowStore::Snapshot& rows, const TableSchema& schema, size_t first, size_t count,
+             std::string& out)
+{
+    size_t end = first < rows.GetRowCount() ? first + std::min(count, rows.GetRowCount() - first) : first;
+    out += "OK " + std::to_string(end - first) + "\n";
+    for (size_t i = first; i < end; i++)
+        AppendCsvRow(out, i, rows.GetRow(i), schema);
+}
+
+#ifdef __linux__
+
+// Remove a socket file left over from a server that did not shut down. Only a socket that refuses
+// connections is removed: a live server's socket, or any other kind of file, stays and bind fails.
+void RemoveStaleSocket(const std::string& path, const sockaddr_un& address)
+{
+    struct stat info;
+    if (lstat(path.c_str(), &info) != 0 || !S_ISSOCK(info.st_mode))
+        return;
+
+    int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (probe < 0)
+        return;
+    bool refused = connect(probe, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0
+        && errno == ECONNREFUSED;
+    close(probe);
+    if (refused)
+        unlink(path.c_str());
+}
+
+int OpenListener(const QueryServer::Options& options, unsigned short& outPort)
+{
+    int fd;
+    if (!options.socketPath.empty()) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (options.socketPath.size() >= sizeof(address.sun_path))
+            return -1;
+        std::memcpy(address.sun_path, options.socketPath.c_str(), options.socketPath.size() + 1);
+
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+            return -1;
+        RemoveStaleSocket(options.socketPath, address);
+        if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+            close(fd);
+            return -1;
+        }
+        outPort = 0;
+    } else {
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(options.port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);   // local tools only
+
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+            return -1;
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        socklen_t length = sizeof(address);
+        if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+            getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+            close(fd);
+            return -1;
+        }
+        outPort = ntohs(address.sin_port);
+    }
+
+    if (listen(fd, SOMAXCONN) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void Wake(int fd)
+{
+    uint64_t one = 1;
+    ssize_t written = write(fd, &one, sizeof(one));
+    (void)written;      // a full counter already means "wake up"
+}
+
+#endif
+
+} // namespace
+
+struct QueryServer::Connection {
+    uint64_t id = 0;
+    int fd = -1;
+    std::string input;              // received, not yet handed to a worker
+    std::string output;             // answered, not yet sent
+    size_t outputSent = 0;
+    uint32_t events = 0;            // registered with epoll
+    bool busy = false;              // a job for this client is with the workers
+    bool peerClosed = false;        // client finished sending; answer what is left, then close
+    bool failed = false;
+
+    ~Connection() {
+#ifdef __linux__
+        if (fd >= 0)
+            close(fd);
+#endif
+    }
+};
+
+struct QueryServer::Job {
+    uint64_t clientId;
+    std::string requests;
+    std::string response;
+};
+
+//--------------------------------------------------
+// Constructor / Destructor
+//--------------------------------------------------
+QueryServer::QueryServer(const VersionedRowStore& rows)
+    : rows(rows)
+{
+}
+
+QueryServer::~QueryServer() {
+    Stop();
+}
+
+//--------------------------------------------------
+// Execute
+// One snapshot answers every request in the block, so a
+// batch sees a single consistent version of the table,
+// and the columns that version was published with.
+//--------------------------------------------------
+std::string QueryServer::Execute(const std::string& requests) {
+    VersionedRowStore::Snapshot snapshot = rows.GetSnapshot();
+
+    std::string out;
+    size_t pos = 0;
+    while (pos < requests.size()) {
+        size_t newline = requests.find('\n', pos);
+        if (newline == std::string::npos)
+            newline = requests.size();
+        std::string line = requests.substr(pos, newline - pos);
+        pos = newline + 1;
+
+        std::vector<std::wstring> args = Tokenize(line);
+        if (args.empty())
+            continue;
+        Answer(args, snapshot, out);
+    }
+    return out;
+}
+
+//--------------------------------------------------
+// Answer one request
+//--------------------------------------------------
+void QueryServer::Answer(const std::vector<std::wstring>& args, const VersionedRowStore::Snapshot& snapshot,
+                         std::string& out) {
+    const TableSchema& tableSchema = snapshot.GetSchema();
+    std::wstring command = ToUpper(args[0]);
+
+    if (command == L"PING") {
+        out += "OK 0\n";
+    }
+    else if (command == L"BATCH") {
+        // The lines that follow arrive in the same job; a bad count is the only thing to report
+        size_t count = 0;
+        if (args.size() != 2 || !ParseCount(args[1], count) || count > kMaxBatch)
+            AppendError(out, "usage: BATCH <count> (at most " + std::to_string(kMaxBatch) + ")");
+    }
+    else if (command == L"SUMMARY") {
+        if (!LookupCache(snapshot.GetVersion(), kSummaryKey, out)) {
+            std::string response;
+            RunSummary(snapshot, response);
+            StoreCache(snapshot.GetVersion(), kSummaryKey, response);
+            out += response;
+        }
+    }
+    else if (command == L"GROUPBY") {
+        size_t column = 0;
+        if (args.size() != 2) {
+            AppendError(out, "usage: GROUPBY <column>");
+        } else if (FindColumn(tableSchema, args[1], column, out) &&
+                   !LookupCache(snapshot.GetVersion(), column, out)) {
+            std::string response;
+            RunGroupBy(snapshot, tableSchema, column, response);
+            StoreCache(snapshot.GetVersion(), column, response);
+            out += response;
+        }
+    }
+    else if (command == L"FILTER") {
+        size_t column = 0;
+        FilterTest test;
+        size_t limit = kDefaultFilterLimit;
+        if ((args.size() != 4 && args.size() != 5) || !ParseOp(args[2], test.op) ||
+            (args.size() == 5 && !ParseCount(args[4], limit))) {
+            AppendError(out, "usage: FILTER <column> <op> <value> [limit], op is = != ~ < <= > >=");
+        } else if (FindColumn(tableSchema, args[1], column, out)) {
+            test.value = test.op == FilterOp::Contains ? ToLower(args[3]) : args[3];
+            test.numeric = tableSchema.GetColumn(column).type != ColumnType::Text &&
+                           ImportValidator::ParseNumber(args[3], test.number, true);
+            RunFilter(snapshot, tableSchema, column, test, std::min(limit, kMaxResultRows), out);
+        }
+    }
+    else if (command == L"ROWS") {
+        size_t first = 0, count = 0;
+        if (args.size() != 3 || !ParseCount(args[1], first) || !ParseCount(args[2], count))
+            AppendError(out, "usage: ROWS <first> <count>");
+        else
+            RunRows(snapshot, tableSchema, first, std::min(count, kMaxResultRows), out);
+    }
+    else {
+        AppendError(out, "unknown command '" + WideToUtf8(args[0]) + "'");
+    }
+}
+
+//--------------------------------------------------
+// Result cache
+// SUMMARY and GROUPBY scan the whole table; their answers are
+// kept until the store publishes a new version (a new schema
+// is a new version too).
+//--------------------------------------------------
+bool QueryServer::LookupCache(uint64_t version, size_t key, std::string& out) {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    if (version != cacheVersion)
+        return false;
+    auto it = cache.find(key);
+    if (it == cache.end())
+        return false;
+    out += it->second;
+    return true;
+}
+
+void QueryServer::StoreCache(uint64_t version, size_t key, const std::string& response) {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    if (version != cacheVersion) {
+        // A worker still on an older snapshot must not replace newer results
+        if (version < cacheVersion)
+            return;
+        cache.clear();
+        cacheVersion = version;
+    }
+    cache[key] = response;
+}
+
+#ifdef __linux__
+
+//--------------------------------------------------
+// Start / Stop
+//--------------------------------------------------
+bool QueryServer::Start(const Options& newOptions) {
+    Stop();
+
+    options = newOptions;
+    if (options.workerCount == 0)
+        options.workerCount = std::max(1u, std::thread::hardware_concurrency());
+    options.maxJobRequests = std::max<size_t>(1, options.maxJobRequests);
+
+    listenFd = OpenListener(options, boundPort);
+    ownsSocketPath = listenFd >= 0 && !options.socketPath.empty();
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    bool ok = listenFd >= 0 && epollFd >= 0 && wakeFd >= 0;
+    if (ok) {
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u64 = kListenId;
+        ok = epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event) == 0;
+        event.data.u64 = kWakeId;
+        ok = ok && epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event) == 0;
+    }
+    if (!ok) {
+        Stop();
+        return false;
+    }
+
+    stopping = false;
+    nextClientId = kFirstClientId;
+    running = true;
+    for (unsigned i = 0; i < options.workerCount; i++)
+        workers.emplace_back(&QueryServer::WorkerLoop, this);
+    loopThread = std::thread(&QueryServer::EventLoop, this);
+    return true;
+}
+
+void QueryServer::Stop() {
+    if (running.exchange(false))
+        Wake(wakeFd);
+    if (loopThread.joinable())
+        loopThread.join();
+
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        stopping = true;
+    }
+    jobReady.notify_all();
+    for (auto& worker : workers)
+        worker.join();
+    workers.clear();
+    pendingJobs.clear();
+    finishedJobs.clear();
+    connections.clear();
+
+    for (int* fd : { &listenFd, &epollFd, &wakeFd }) {
+        if (*fd >= 0)
+            close(*fd);
+        *fd = -1;
+    }
+    // Only the socket file this server created is removed, never one it failed to bind over
+    if (ownsSocketPath)
+        unlink(options.socketPath.c_str());
+    ownsSocketPath = false;
+    options.socketPath.clear();
+}
+
+//--------------------------------------------------
+// Event Loop
+// Only this thread touches sockets and connection state;
+// workers see nothing but the request text of their job.
+//--------------------------------------------------
+void QueryServer::EventLoop() {
+    epoll_event events[64];
+
+    while (running) {
+        int count = epoll_wait(epollFd, events, 64, -1);
+        if (count < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        for (int i = 0; i < count && running; i++) {
+            uint64_t id = events[i].data.u64;
+            if (id == kListenId) {
+                AcceptClients();
+                continue;
+            }
+            if (id == kWakeId) {
+                uint64_t value;
+                ssize_t got = read(wakeFd, &value, sizeof(value));
+                (void)got;
+                FinishJobs();
+                continue;
+            }
+
+            auto it = connections.find(id);
+            if (it == connections.end())
+                continue;
+            Connection& connection = *it->second;
+
+            if (events[i].events & (EPOLLERR | EPOLLHUP))
+                connection.failed = true;
+            if (!connection.failed && (events[i].events & EPOLLIN))
+                ReadClient(connection);
+            if (!connection.failed && (events[i].events & EPOLLOUT))
+                WriteClient(connection);
+            Settle(connection);
+        }
+    }
+}
+
+void QueryServer::AcceptClients() {
+    for (;;) {
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+            return;     // EAGAIN: no more waiting; other errors (e.g. EMFILE) are retried on the next event
+
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));     // fails harmlessly on Unix sockets
+
+        auto connection = std::make_unique<Connection>();
+        connection->id = nextClientId++;
+        connection->fd = fd;
+        connection->events = EPOLLIN;
+
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u64 = connection->id;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) != 0)
+            continue;   // closed by the Connection destructor
+        connections.emplace(connection->id, std::move(connection));
+    }
+}
+
+void QueryServer::ReadClient(Connection& connection) {
+    char buffer[kReadBlock];
+    while (connection.input.size() < kMaxPendingInput) {
+        ssize_t got = recv(connection.fd, buffer, sizeof(buffer), 0);
+        if (got > 0) {
+            connection.input.append(buffer, static_cast<size_t>(got));
+            continue;
+        }
+        if (got == 0) {
+            // Treat a last line without a newline as complete
+            connection.peerClosed = true;
+            if (!connection.input.empty() && connection.input.back() != '\n')
+                connection.input += '\n';
+        } else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            connection.failed = true;
+        }
+        break;
+    }
+    Dispatch(connection);
+}
+
+void QueryServer::WriteClient(Connection& connection) {
+    while (connection.outputSent < connection.output.size()) {
+        ssize_t sent = send(connection.fd, connection.output.data() + connection.outputSent,
+            connection.output.size() - connection.outputSent, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                connection.failed = true;
+            break;
+        }
+        connection.outputSent += static_cast<size_t>(sent);
+    }
+
+    if (connection.outputSent == connection.output.size()) {
+        connection.output.clear();
+        connection.outputSent = 0;
+    }
+    Dispatch(connection);      // resumes a client paused for unsent output
+}
+
+//--------------------------------------------------
+// Dispatch
+// Hand every complete request received so far (up to
+// maxJobRequests, and never part of a BATCH) to one job.
+// A client has at most one job in flight, which keeps its
+// responses in request order.
+//--------------------------------------------------
+void QueryServer::Dispatch(Connection& connection) {
+    if (connection.busy || connection.failed ||
+        connection.output.size() - connection.outputSent > kMaxPendingOutput)
+        return;
+
+    const char* data = connection.input.data();
+    size_t length = connection.input.size();
+    size_t end = 0;             // end of the last complete request
+    size_t requests = 0;
+
+    while (requests < options.maxJobRequests) {
+        const char* newline = static_cast<const char*>(std::memchr(data + end, '\n', length - end));
+        if (!newline)
+            break;
+        size_t lineEnd = static_cast<size_t>(newline - data) + 1;
+
+        size_t batch = 0;
+        if (IsBatchLine(data + end, newline, batch)) {
+            // The whole batch or nothing
+            size_t batchEnd = lineEnd;
+            size_t found = 0;
+            while (found < batch) {
+                const char* next = static_cast<const char*>(std::memchr(data + batchEnd, '\n', length - batchEnd));
+                if (!next)
+                    break;
+                batchEnd = static_cast<size_t>(next - data) + 1;
+                found++;
+            }
+            if (found < batch)
+                break;
+            if (requests > 0 && requests + batch + 1 > options.maxJobRequests)
+                break;
+            lineEnd = batchEnd;
+            requests += batch;
+        }
+
+        end = lineEnd;
+        requests++;
+    }
+
+    if (end == 0) {
+        // Nothing complete yet. A line or batch that can never fit, or one cut off
+        // by the client closing, ends the connection.
+        if (length >= kMaxPendingInput || (length > 0 && connection.peerClosed) ||
+            (length > kMaxLine && !std::memchr(data, '\n', length)))
+            connection.failed = true;
+        return;
+    }
+
+    auto job = std::make_unique<Job>();
+    job->clientId = connection.id;
+    job->requests.assign(connection.input, 0, end);
+    connection.input.erase(0, end);
+    connection.busy = true;
+
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        pendingJobs.push_back(std::move(job));
+    }
+    jobReady.notify_one();
+}
+
+//--------------------------------------------------
+// Worker Loop
+//--------------------------------------------------
+void QueryServer::WorkerLoop() {
+    for (;;) {
+        std::unique_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(jobMutex);
+            jobReady.wait(lock, [this] { return stopping || !pendingJobs.empty(); });
+            if (stopping)
+                return;
+            job = std::move(pendingJobs.front());
+            pendingJobs.pop_front();
+        }
+
+        job->response = Execute(job->requests);
+
+        bool wasEmpty;
+        {
+            std::lock_guard<std::mutex> lock(jobMutex);
+            wasEmpty = finishedJobs.empty();
+            finishedJobs.push_back(std::move(job));
+        }
+        // The loop takes every finished job on one wake-up
+        if (wasEmpty)
+            Wake(wakeFd);
+    }
+}
+
+//--------------------------------------------------
+// Finish Jobs (event loop thread)
+//--------------------------------------------------
+void QueryServer::FinishJobs() {
+    std::vector<std::unique_ptr<Job>> done;
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        done.swap(finishedJobs);
+    }
+
+    for (auto& job : done) {
+        auto it = connections.find(job->clientId);
+        if (it == connections.end())
+            continue;   // client went away while its job ran
+        Connection& connection = *it->second;
+
+        connection.busy = false;
+        if (connection.output.empty())
+            connection.output.swap(job->response);
+        else
+            connection.output += job->response;
+        WriteClient(connection);
+        Settle(connection);
+    }
+}
+
+//--------------------------------------------------
+// Settle
+// After any change to a connection: close it if it is done,
+// otherwise ask epoll for the events it now needs.
+//--------------------------------------------------
+void QueryServer::Settle(Connection& connection) {
+    bool drained = !connection.busy && connection.output.empty() && connection.input.empty();
+    if (connection.failed || (connection.peerClosed && drained)) {
+        connections.erase(connection.id);
+        return;
+    }
+
+    uint32_t wanted = 0;
+    if (!connection.peerClosed && connection.input.size() < kMaxPendingInput)
+        wanted |= EPOLLIN;
+    if (!connection.output.empty())
+        wanted |= EPOLLOUT;
+
+    if (wanted != connection.events) {
+        epoll_event event{};
+        event.events = wanted;
+        event.data.u64 = connection.id;
+        if (epoll_ctl(epollFd, EPOLL_CTL_MOD, connection.fd, &event) == 0)
+            connection.events = wanted;
+    }
+}
+
+bool QueryServer::IsRunning() const {
+    return running;
+}
+
+unsigned short QueryServer::GetPort() const {
+    return boundPort;
+}
+
+#else
+
+//--------------------------------------------------
+// Without epoll the server is not available; Execute still works
+//--------------------------------------------------
+bool QueryServer::Start(const Options& newOptions) {
+    options = newOptions;
+    return false;
+}
+
+void QueryServer::Stop() {}
+
+bool QueryServer::IsRunning() const {
+    return false;
+}
+
+unsigned short QueryServer::GetPort() const {
+    return 0;
+}
+
+#endif
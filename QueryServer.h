@@ -0,0 +1,104 @@
+//Header for the QueryServer class. The purpose of the class is to let several local tools query one open cost sheet
+//instead of each reloading the file. The server listens on a localhost TCP port or a Unix domain socket, and one
+//event loop thread (epoll) handles every connection. Complete requests are handed to a pool of worker threads, and
+//each job answers them from a single snapshot of the shared VersionedRowStore, rows and columns alike.
+//
+//Protocol: one request per line (UTF-8, arguments separated by spaces, "double quotes" around arguments that contain
+//spaces). Each response starts with "OK <n> ..." and is followed by n lines, or is a single "ERR <message>" line.
+//  PING                                  OK 0
+//  SUMMARY                               OK 1, then rows, total cost, median and p95 cost, tab-separated
+//  GROUPBY <column>                      OK <groups>, then key, rows, total cost per group (sorted by key)
+//  FILTER <column> <op> <value> [limit]  OK <n> <matches>, then index and CSV row of the first n matches
+//                                        (op is = != ~ < <= > >=; ~ means contains; limit defaults to 100)
+//  ROWS <first> <count>                  OK <n>, then index and CSV row for each row in the range
+//  BATCH <k>                             the next k lines are answered together, from the same snapshot
+//                                        (BATCH itself has no response unless k is invalid)
+//Clients may pipeline: send many requests without waiting. Responses come back in request order, and requests that
+//arrive together are answered as one job.
+//
+//The event loop uses epoll, so the server runs on Linux only; Start returns false elsewhere.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "TableSchema.h"
+#include "VersionedRowStore.h"
+
+class QueryServer {
+public:
+    struct Options {
+        std::string socketPath;         // Unix domain socket (a stale one is replaced); if empty, TCP on 127.0.0.1
+        unsigned short port = 7411;     // 0 picks a free port (see GetPort)
+        unsigned workerCount = 0;       // 0 = one per core
+        size_t maxJobRequests = 256;    // pipelined requests answered by one job
+    };
+
+    // The store must outlive the server. It may be edited while the server runs; a sheet reloaded
+    // with different columns is published with VersionedRowStore::Replace.
+    explicit QueryServer(const VersionedRowStore& rows);
+    ~QueryServer();
+    QueryServer(const QueryServer&) = delete;
+    QueryServer& operator=(const QueryServer&) = delete;
+
+    bool Start(const Options& options);
+    void Stop();
+    bool IsRunning() const;
+    unsigned short GetPort() const;
+
+    // Answer a block of request lines (as a worker does) without a socket
+    std::string Execute(const std::string& requests);
+
+private:
+    struct Connection;
+    struct Job;
+
+    void EventLoop();
+    void WorkerLoop();
+    void AcceptClients();
+    void ReadClient(Connection& connection);
+    void WriteClient(Connection& connection);
+    void Dispatch(Connection& connection);
+    void FinishJobs();
+    void Settle(Connection& connection);
+
+    void Answer(const std::vector<std::wstring>& args, const VersionedRowStore::Snapshot& snapshot, std::string& out);
+    bool LookupCache(uint64_t version, size_t key, std::string& out);
+    void StoreCache(uint64_t version, size_t key, const std::string& response);
+
+    const VersionedRowStore& rows;
+
+    Options options;
+    int listenFd = -1;
+    int epollFd = -1;
+    int wakeFd = -1;                // eventfd: stop requested or jobs finished
+    unsigned short boundPort = 0;
+    bool ownsSocketPath = false;    // bound options.socketPath, so Stop removes it
+    std::atomic<bool> running{ false };
+    std::thread loopThread;
+
+    // Owned by the event loop thread
+    std::unordered_map<uint64_t, std::unique_ptr<Connection>> connections;
+    uint64_t nextClientId = 0;
+
+    // Worker pool
+    std::vector<std::thread> workers;
+    std::mutex jobMutex;
+    std::condition_variable jobReady;
+    std::deque<std::unique_ptr<Job>> pendingJobs;
+    std::vector<std::unique_ptr<Job>> finishedJobs;
+    bool stopping = false;
+
+    // Results that only depend on the data, reused until the store changes
+    std::mutex cacheMutex;
+    uint64_t cacheVersion = 0;
+    std::unordered_map<size_t, std::string> cache;     // SUMMARY, or GROUPBY by column
+};
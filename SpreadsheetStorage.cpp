@@ -1 +1,1036 @@
-//Blank for now
\ No newline at end of file
+//Implementation file for the SpreadsheetStorage functions that are too large to live in the header.
+//The CSV writer formats chunks of rows on several threads and writes them in order through an AtomicFile.
+//The XLSX writer streams rows straight into the zipped sheet XML, and the reader pulls the sheet back out
+//one <row> element at a time, so neither side ever builds the whole document in memory.
+
+#include "SpreadsheetStorage.h"
+#include "AtomicFile.h"
+#include "FormulaEngine.h"
+#include "ImportValidator.h"
+#include "PagedRowStore.h"
+#include "TextEncoding.h"
+#include "ZipArchive.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <unordered_map>
+
+namespace {
+
+// Rows formatted per chunk by one thread in the CSV writer (about 1-2 MB of text)
+const size_t kCsvChunkRows = 16384;
+
+// Rows read from or written to a PagedRowStore at a time
+const size_t kPagedBlockRows = 65536;
+
+// Flush the sheet buffer to the zip once it reaches this size
+const size_t kFlushThreshold = 256 * 1024;
+
+// Shared string table limits. Strings past the limit are written inline,
+// which keeps the writer's memory bounded on very large exports.
+const size_t kMaxSharedStrings = 200000;
+const size_t kMaxSharedStringChars = 8 * 1024 * 1024;
+
+// Cell style indexes in styles.xml
+const char* kCurrencyStyle = "1";
+const char* kHeaderStyle   = "2";
+
+const char* kContentTypesXml =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>\n"
+    "<Types xmlns=\"http://schemas.openxmlformats.org/package/2006/content-types\">"
+    "<Default Extension=\"rels\" ContentType=\"application/vnd.openxmlformats-package.relationships+xml\"/>"
+    "<Default Extension=\"xml\" ContentType=\"application/xml\"/>"
+    "<Override PartName=\"/xl/workbook.xml\" ContentType=\"application/vnd.openxmlformats-officedocument.spreadsheetml.sheet.main+xml\"/>"
+    "<Override PartName=\"/xl/worksheets/sheet1.xml\" ContentType=\"application/vnd.openxmlformats-officedocument.spreadsheetml.worksheet+xml\"/>"
+    "<Override PartName=\"/xl/styles.xml\" ContentType=\"application/vnd.openxmlformats-officedocument.spreadsheetml.styles+xml\"/>"
+    "<Override PartName=\"/xl/sharedStrings.xml\" ContentType=\"application/vnd.openxmlformats-officedocument.spreadsheetml.sharedStrings+xml\"/>"
+    "</Types>";
+
+const char* kRootRelsXml =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>\n"
+    "<Relationships xmlns=\"http://schemas.openxmlformats.org/package/2006/relationships\">"
+    "<Relationship Id=\"rId1\" Type=\"http://schemas.openxmlformats.org/officeDocument/2006/relationships/officeDocument\" Target=\"xl/workbook.xml\"/>"
+    "</Relationships>";
+
+const char* kWorkbookXml =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>\n"
+    "<workbook xmlns=\"http://schemas.openxmlformats.org/spreadsheetml/2006/main\" "
+    "xmlns:r=\"http://schemas.openxmlformats.org/officeDocument/2006/relationships\">"
+    "<sheets><sheet name=\"Cost Tracker\" sheetId=\"1\" r:id=\"rId1\"/></sheets>"
+    "</workbook>";
+
+const char* kWorkbookRelsXml =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>\n"
+    "<Relationships xmlns=\"http://schemas.openxmlformats.org/package/2006/relationships\">"
+    "<Relationship Id=\"rId1\" Type=\"http://schemas.openxmlformats.org/officeDocument/2006/relationships/worksheet\" Target=\"worksheets/sheet1.xml\"/>"
+    "<Relationship Id=\"rId2\" Type=\"http://schemas.openxmlformats.org/officeDocument/2006/relationships/styles\" Target=\"styles.xml\"/>"
+    "<Relationship Id=\"rId3\" Type=\"http://schemas.openxmlformats.org/officeDocument/2006/relationships/sharedStrings\" Target=\"sharedStrings.xml\"/>"
+    "</Relationships>";
+
+const char* kStylesXml =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>\n"
+    "<styleSheet xmlns=\"http://schemas.openxmlformats.org/spreadsheetml/2006/main\">"
+    "<numFmts count=\"1\"><numFmt numFmtId=\"164\" formatCode=\"&quot;$&quot;#,##0.00\"/></numFmts>"
+    "<fonts count=\"2\">"
+    "<font><sz val=\"11\"/><name val=\"Calibri\"/><family val=\"2\"/></font>"
+    "<font><b/><sz val=\"11\"/><name val=\"Calibri\"/><family val=\"2\"/></font>"
+    "</fonts>"
+    "<fills count=\"2\"><fill><patternFill patternType=\"none\"/></fill><fill><patternFill patternType=\"gray125\"/></fill></fills>"
+    "<borders count=\"1\"><border><left/><right/><top/><bottom/><diagonal/></border></borders>"
+    "<cellStyleXfs count=\"1\"><xf numFmtId=\"0\" fontId=\"0\" fillId=\"0\" borderId=\"0\"/></cellStyleXfs>"
+    "<cellXfs count=\"3\">"
+    "<xf numFmtId=\"0\" fontId=\"0\" fillId=\"0\" borderId=\"0\" xfId=\"0\"/>"
+    "<xf numFmtId=\"164\" fontId=\"0\" fillId=\"0\" borderId=\"0\" xfId=\"0\" applyNumberFormat=\"1\"/>"
+    "<xf numFmtId=\"0\" fontId=\"1\" fillId=\"0\" borderId=\"0\" xfId=\"0\" applyFont=\"1\"/>"
+    "</cellXfs>"
+    "<cellStyles count=\"1\"><cellStyle name=\"Normal\" xfId=\"0\" builtinId=\"0\"/></cellStyles>"
+    "</styleSheet>";
+
+const char* kSheetStartXml =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>\n"
+    "<worksheet xmlns=\"http://schemas.openxmlformats.org/spreadsheetml/2006/main\">"
+    "<cols>"
+    "<col min=\"1\" max=\"1\" width=\"16\" customWidth=\"1\"/>"
+    "<col min=\"2\" max=\"3\" width=\"18\" customWidth=\"1\"/>"
+    "<col min=\"4\" max=\"4\" width=\"30\" customWidth=\"1\"/>"
+    "<col min=\"5\" max=\"5\" width=\"10\" customWidth=\"1\"/>"
+    "<col min=\"6\" max=\"7\" width=\"13\" customWidth=\"1\"/>"
+    "<col min=\"8\" max=\"8\" width=\"30\" customWidth=\"1\"/>";
+
+// Width of extra (non built-in) and computed columns, in characters
+const int kExtraColumnChars = 18;
+
+// Longest text FormulaEngine::GetText produces, plus a separator
+const size_t kMaxComputedText = FormulaEngine::kMaxTextLength + 3;
+
+const char* kSheetEndXml = "</sheetData></worksheet>";
+
+void AppendNumber(std::string& out, double value)
+{
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.15g", value);
+    out += buffer;
+}
+
+void AppendColumnName(std::string& out, int column)
+{
+    char letters[4];
+    int count = 0;
+    for (column++; column > 0 && count < 4; column = (column - 1) / 26)
+        letters[count++] = static_cast<char>('A' + (column - 1) % 26);
+    while (count > 0)
+        out += letters[--count];
+}
+
+void AppendSheetStart(std::string& out, const TableSchema& schema)
+{
+    out += kSheetStartXml;
+    size_t added = schema.GetExtraCount() + schema.GetComputedColumns().size();
+    if (added > 0) {
+        size_t first = schema.GetColumnCount() - schema.GetExtraCount() + 1;
+        out += "<col min=\"";
+        out += std::to_string(first);
+        out += "\" max=\"";
+        out += std::to_string(first + added - 1);
+        out += "\" width=\"";
+        out += std::to_string(kExtraColumnChars);
+        out += "\" customWidth=\"1\"/>";
+    }
+    out += "</cols><sheetData>";
+}
+
+// Escape text for XML and drop control characters XML 1.0 cannot carry
+void AppendXmlText(std::string& out, const std::wstring& text)
+{
+    size_t runStart = 0;
+    for (size_t i = 0; i <= text.size(); i++) {
+        wchar_t ch = i < text.size() ? text[i] : L'\0';
+        const char* entity = nullptr;
+        bool drop = false;
+
+        if (i == text.size())                         drop = true;
+        else if (ch == L'&')                          entity = "&amp;";
+        else if (ch == L'<')                          entity = "&lt;";
+        else if (ch == L'>')                          entity = "&gt;";
+        else if (ch == L'"')                          entity = "&quot;";
+        else if (ch < 0x20 && ch != L'\t' && ch != L'\n' && ch != L'\r') drop = true;
+
+        if (entity || drop) {
+            AppendUtf8(out, text.data() + runStart, i - runStart);
+            if (entity)
+                out += entity;
+            runStart = i + 1;
+        }
+    }
+}
+
+// Maps each distinct string to its index in sharedStrings.xml
+class SharedStringTable {
+public:
+    // Returns false when the table is full and the caller should write the string inline
+    bool Lookup(const std::wstring& text, size_t& outIndex) {
+        auto it = indexes.find(text);
+        if (it != indexes.end()) {
+            outIndex = it->second;
+            references++;
+            return true;
+        }
+
+        if (order.size() >= kMaxSharedStrings || chars + text.size() > kMaxSharedStringChars)
+            return false;
+
+        it = indexes.emplace(text, order.size()).first;
+        order.push_back(&it->first);
+        chars += text.size();
+        outIndex = it->second;
+        references++;
+        return true;
+    }
+
+    const std::vector<const std::wstring*>& Strings() const { return order; }
+    size_t References() const { return references; }
+
+private:
+    std::unordered_map<std::wstring, size_t> indexes;
+    std::vector<const std::wstring*> order;
+    size_t chars = 0;
+    size_t references = 0;
+};
+
+void AppendStringCell(std::string& out, SharedStringTable& strings, int column, size_t rowNumber,
+                      const std::wstring& text, const char* style)
+{
+    out += "<c r=\"";
+    AppendColumnName(out, column);
+    AppendNumber(out, static_cast<double>(rowNumber));
+    out += '"';
+    if (style) {
+        out += " s=\"";
+        out += style;
+        out += '"';
+    }
+
+    size_t index = 0;
+    if (strings.Lookup(text, index)) {
+        out += " t=\"s\"><v>";
+        AppendNumber(out, static_cast<double>(index));
+        out += "</v></c>";
+    } else {
+        out += " t=\"inlineStr\"><is><t xml:space=\"preserve\">";
+        AppendXmlText(out, text);
+        out += "</t></is></c>";
+    }
+}
+
+void AppendNumberCell(std::string& out, int column, size_t rowNumber, double value, const char* style)
+{
+    out += "<c r=\"";
+    AppendColumnName(out, column);
+    AppendNumber(out, static_cast<double>(rowNumber));
+    out += '"';
+    if (style) {
+        out += " s=\"";
+        out += style;
+        out += '"';
+    }
+    out += "><v>";
+    AppendNumber(out, value);
+    out += "</v></c>";
+}
+
+void AppendDataRow(std::string& out, SharedStringTable& strings, size_t rowNumber, const DataRow& row,
+                   const TableSchema& schema, const FormulaEngine* formulas)
+{
+    out += "<row r=\"";
+    AppendNumber(out, static_cast<double>(rowNumber));
+    out += "\">";
+
+    int columnCount = static_cast<int>(schema.GetColumnCount());
+    for (int column = 0; column < columnCount; column++) {
+        const std::wstring& text = schema.GetField(row, column);
+        if (text.empty())
+            continue;
+
+        // Costs are stored as numbers so Excel can sum them; the text form is kept if it does not parse
+        double value = 0.0;
+        ColumnType type = schema.GetColumn(column).type;
+        if (type != ColumnType::Text && schema.ParseValue(row, column, value))
+            AppendNumberCell(out, column, rowNumber, value, type == ColumnType::Money ? kCurrencyStyle : nullptr);
+        else
+            AppendStringCell(out, strings, column, rowNumber, text, nullptr);
+    }
+
+    // Computed values, for programs that read the file without recalculating
+    int computedCount = formulas ? std::min(formulas->GetColumnCount(),
+                                            static_cast<int>(schema.GetComputedColumns().size())) : 0;
+    int formulaRow = static_cast<int>(rowNumber - 2);
+    for (int c = 0; c < computedCount && formulaRow < formulas->GetRowCount(); c++) {
+        double value = formulas->GetValue(formulaRow, c);
+        if (std::isfinite(value))
+            AppendNumberCell(out, columnCount + c, rowNumber, value, nullptr);
+    }
+
+    out += "</row>";
+}
+
+//--------------------------------------------------
+// XML reading helpers
+//--------------------------------------------------
+bool IsNameEnd(char ch)
+{
+    return ch == ' ' || ch == '>' || ch == '/' || ch == '\t' || ch == '\r' || ch == '\n';
+}
+
+// Find "<tag" as a whole element name starting at pos
+size_t FindElement(const std::string& xml, const std::string& tag, size_t pos, size_t end)
+{
+    std::string open = "<" + tag;
+    while ((pos = xml.find(open, pos)) != std::string::npos && pos < end) {
+        size_t after = pos + open.size();
+        if (after < xml.size() && IsNameEnd(xml[after]))
+            return pos;
+        pos = after;
+    }
+    return std::string::npos;
+}
+
+std::string GetAttribute(const std::string& startTag, const char* name)
+{
+    std::string key = std::string(" ") + name + "=";
+    size_t pos = startTag.find(key);
+    if (pos == std::string::npos)
+        return std::string();
+
+    pos += key.size();
+    if (pos >= startTag.size())
+        return std::string();
+
+    char quote = startTag[pos];
+    size_t end = startTag.find(quote, pos + 1);
+    if (end == std::string::npos)
+        return std::string();
+    return startTag.substr(pos + 1, end - pos - 1);
+}
+
+void AppendUnescaped(std::wstring& out, const std::string& xml, size_t begin, size_t end)
+{
+    size_t runStart = begin;
+    for (size_t i = begin; i < end; i++) {
+        if (xml[i] != '&')
+            continue;
+
+        size_t semi = xml.find(';', i);
+        if (semi == std::string::npos || semi >= end)
+            break;
+
+        AppendWide(out, xml.data() + runStart, i - runStart);
+        std::string entity = xml.substr(i + 1, semi - i - 1);
+
+        if (entity == "amp")       out += L'&';
+        else if (entity == "lt")   out += L'<';
+        else if (entity == "gt")   out += L'>';
+        else if (entity == "quot") out += L'"';
+        else if (entity == "apos") out += L'\'';
+        else if (!entity.empty() && entity[0] == '#') {
+            unsigned long cp = (entity.size() > 1 && (entity[1] == 'x' || entity[1] == 'X'))
+                ? std::strtoul(entity.c_str() + 2, nullptr, 16)
+                : std::strtoul(entity.c_str() + 1, nullptr, 10);
+            AppendCodePoint(out, cp);
+        }
+
+        i = semi;
+        runStart = semi + 1;
+    }
+    AppendWide(out, xml.data() + runStart, end - runStart);
+}
+
+// Concatenate the text of every <t> element (rich text runs), skipping phonetic hints
+std::wstring CollectText(const std::string& xml, size_t begin, size_t end)
+{
+    std::wstring text;
+    size_t pos = begin;
+
+    while ((pos = FindElement(xml, "t", pos, end)) != std::string::npos) {
+        size_t phonetic = FindElement(xml, "rPh", begin, pos);
+        if (phonetic != std::string::npos) {
+            size_t phoneticEnd = xml.find("</rPh>", phonetic);
+            if (phoneticEnd == std::string::npos || phoneticEnd >= end)
+                break;
+            pos = begin = phoneticEnd + 6;
+            continue;
+        }
+
+        size_t gt = xml.find('>', pos);
+        if (gt == std::string::npos || gt >= end)
+            break;
+        if (xml[gt - 1] == '/') {
+            pos = begin = gt + 1;
+            continue;
+        }
+
+        size_t close = xml.find("</t>", gt);
+        if (close == std::string::npos || close > end)
+            break;
+
+        AppendUnescaped(text, xml, gt + 1, close);
+        pos = begin = close + 4;
+    }
+    return text;
+}
+
+// Feeds zip data through and hands each complete <tag>...</tag> element to the callback.
+// Only the unfinished tail of the stream is kept between pieces.
+class ElementStream {
+public:
+    ElementStream(const std::string& tag, std::function<void(const std::string&)> onElement)
+        : tag(tag), closeTag("</" + tag + ">"), onElement(std::move(onElement)) {}
+
+    bool Feed(const char* data, size_t size) {
+        pending.append(data, size);
+
+        size_t consumed = 0;
+        for (;;) {
+            size_t start = FindElement(pending, tag, consumed, pending.size());
+            if (start == std::string::npos) {
+                // Keep enough bytes for a start tag split across pieces
+                size_t keep = tag.size() + 1;
+                consumed = pending.size() > keep ? std::max(consumed, pending.size() - keep) : consumed;
+                break;
+            }
+
+            size_t gt = pending.find('>', start);
+            if (gt == std::string::npos) {
+                consumed = start;
+                break;
+            }
+
+            size_t end;
+            if (pending[gt - 1] == '/') {
+                end = gt + 1;
+            } else {
+                size_t close = pending.find(closeTag, gt);
+                if (close == std::string::npos) {
+                    consumed = start;
+                    break;
+                }
+                end = close + closeTag.size();
+            }
+
+            element.assign(pending, start, end - start);
+            onElement(element);
+            consumed = end;
+        }
+
+        pending.erase(0, consumed);
+        return true;
+    }
+
+private:
+    std::string tag;
+    std::string closeTag;
+    std::function<void(const std::string&)> onElement;
+    std::string pending;
+    std::string element;
+};
+
+// Last column Excel allows (XFD)
+const int kMaxColumns = 16384;
+
+int ColumnFromReference(const std::string& ref)
+{
+    int column = 0;
+    size_t i = 0;
+    for (; i < ref.size() && ref[i] >= 'A' && ref[i] <= 'Z'; i++)
+        column = column * 26 + (ref[i] - 'A' + 1);
+    return i == 0 ? -1 : column - 1;
+}
+
+std::wstring FormatNumber(double value)
+{
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.15g", value);
+    return Utf8ToWide(buffer, std::char_traits<char>::length(buffer));
+}
+
+// A number cell as text for a column of the given type. Money keeps every digit of the value
+// (ImportValidator adds the cents); a currency-formatted cell in a Text column reads as shown.
+std::wstring NumberCellText(double number, bool currency, ColumnType type)
+{
+    if (type == ColumnType::Money || (type == ColumnType::Text && currency))
+        return number < 0 ? L"-$" + FormatNumber(-number) : L"$" + FormatNumber(number);
+    return FormatNumber(number);
+}
+
+// Which cell styles (cellXfs indexes) show a number as currency: a built-in currency
+// format (ids 5 to 8) or a custom one with '$' in its format code
+std::vector<bool> ReadCurrencyStyles(ZipReader& zip)
+{
+    std::vector<bool> currency;
+    std::string styles;
+    if (!zip.HasEntry("xl/styles.xml") || !zip.ReadEntry("xl/styles.xml", styles))
+        return currency;
+
+    std::vector<std::string> currencyFormats;
+    size_t pos = 0;
+    while ((pos = FindElement(styles, "numFmt", pos, styles.size())) != std::string::npos) {
+        std::string tag = styles.substr(pos, styles.find('>', pos) - pos);
+        pos++;
+        if (GetAttribute(tag, "formatCode").find('$') != std::string::npos)
+            currencyFormats.push_back(GetAttribute(tag, "numFmtId"));
+    }
+
+    size_t begin = FindElement(styles, "cellXfs", 0, styles.size());
+    size_t end = begin == std::string::npos ? std::string::npos : styles.find("</cellXfs>", begin);
+    if (end == std::string::npos)
+        return currency;
+
+    pos = begin;
+    while ((pos = FindElement(styles, "xf", pos, end)) != std::string::npos) {
+        std::string tag = styles.substr(pos, styles.find('>', pos) - pos);
+        pos++;
+        std::string id = GetAttribute(tag, "numFmtId");
+        int builtIn = std::atoi(id.c_str());
+        currency.push_back((builtIn >= 5 && builtIn <= 8)
+            || std::find(currencyFormats.begin(), currencyFormats.end(), id) != currencyFormats.end());
+    }
+    return currency;
+}
+
+// Call onCell(column, text, isNumber, number, currency) for each cell of a <row> element that holds a
+// value. currency is set for a number shown with a currency format (see ReadCurrencyStyles).
+template <typename OnCell>
+void ForEachCell(const std::string& rowXml, const std::vector<std::wstring>& sharedStrings,
+                 const std::vector<bool>& currencyStyles, OnCell onCell)
+{
+    int nextColumn = 0;
+    size_t pos = 0;
+
+    while ((pos = FindElement(rowXml, "c", pos, rowXml.size())) != std::string::npos) {
+        size_t gt = rowXml.find('>', pos);
+        if (gt == std::string::npos)
+            break;
+
+        std::string startTag = rowXml.substr(pos, gt - pos);
+        std::string ref = GetAttribute(startTag, "r");
+        int column = ref.empty() ? nextColumn : ColumnFromReference(ref);
+        nextColumn = column + 1;
+
+        if (rowXml[gt - 1] == '/') {
+            pos = gt + 1;
+            continue;
+        }
+
+        size_t close = rowXml.find("</c>", gt);
+        if (close == std::string::npos)
+            break;
+        pos = close + 4;
+
+        if (column < 0 || column >= kMaxColumns)
+            continue;
+
+        std::string type = GetAttribute(startTag, "t");
+        std::wstring value;
+        bool isNumber = false;
+        double number = 0.0;
+        size_t style = std::strtoul(GetAttribute(startTag, "s").c_str(), nullptr, 10);
+        bool currency = style < currencyStyles.size() && currencyStyles[style];
+
+        if (type == "inlineStr") {
+            value = CollectText(rowXml, gt + 1, close);
+        } else {
+            size_t v = FindElement(rowXml, "v", gt, close);
+            size_t vEnd = v == std::string::npos ? std::string::npos : rowXml.find("</v>", v);
+            if (v == std::string::npos || vEnd == std::string::npos || vEnd > close)
+                continue;
+            size_t vStart = rowXml.find('>', v) + 1;
+            AppendUnescaped(value, rowXml, vStart, vEnd);
+
+            if (type == "s") {
+                size_t index = std::wcstoul(value.c_str(), nullptr, 10);
+                value = index < sharedStrings.size() ? sharedStrings[index] : std::wstring();
+            } else if (type.empty() || type == "n") {
+                isNumber = ImportValidator::ParseNumber(value, number, false);
+            }
+        }
+
+        if (!value.empty())
+            onCell(column, value, isNumber, number, currency);
+    }
+}
+
+// Work out which part holds the first worksheet (workbook.xml -> workbook.xml.rels)
+std::string FindFirstSheet(ZipReader& zip)
+{
+    const std::string fallback = "xl/worksheets/sheet1.xml";
+
+    std::string workbook, rels;
+    if (!zip.ReadEntry("xl/workbook.xml", workbook) || !zip.ReadEntry("xl/_rels/workbook.xml.rels", rels))
+        return fallback;
+
+    size_t sheet = FindElement(workbook, "sheet", 0, workbook.size());
+    if (sheet == std::string::npos)
+        return fallback;
+    std::string sheetTag = workbook.substr(sheet, workbook.find('>', sheet) - sheet);
+    std::string id = GetAttribute(sheetTag, "r:id");
+
+    size_t pos = 0;
+    while ((pos = FindElement(rels, "Relationship", pos, rels.size())) != std::string::npos) {
+        std::string relTag = rels.substr(pos, rels.find('>', pos) - pos);
+        pos++;
+        if (GetAttribute(relTag, "Id") != id)
+            continue;
+
+        std::string target = GetAttribute(relTag, "Target");
+        if (!target.empty() && target[0] == '/')
+            target.erase(0, 1);
+        else
+            target = "xl/" + target;
+        return zip.HasEntry(target) ? target : fallback;
+    }
+    return fallback;
+}
+
+//--------------------------------------------------
+// CSV writing helpers
+//--------------------------------------------------
+struct CsvChunk {
+    std::string text;       // grown to the worst case once and reused
+    size_t used = 0;
+};
+
+void FormatCsvChunk(const std::vector<DataRow>& rows, size_t begin, size_t end, const TableSchema& schema,
+                    const FormulaEngine* formulas, CsvChunk& chunk)
+{
+    size_t extraCount = schema.GetExtraCount();
+    size_t computedCount = schema.GetComputedColumns().size();
+    size_t valueCount = formulas ? std::min<size_t>(formulas->GetColumnCount(), computedCount) : 0;
+    size_t valueRows = formulas ? static_cast<size_t>(formulas->GetRowCount()) : 0;
+
+    // Size for the worst case so the loop below never reallocates
+    size_t bound = 0;
+    for (size_t i = begin; i < end; ++i) {
+        bound += CostTrackerSchema::CsvBound(rows[i]) + extraCount * 3 + computedCount * kMaxComputedText;
+        for (size_t e = 0; e < extraCount && e < rows[i].extra.size(); ++e)
+            bound += CsvFieldBound(rows[i].extra[e]);
+    }
+    if (chunk.text.size() < bound)
+        chunk.text.resize(bound);
+
+    char* start = &chunk.text[0];
+    char* out = start;
+    for (size_t i = begin; i < end; ++i) {
+        // Built-in columns are unrolled at compile time; extras follow in schema order
+        out = CostTrackerSchema::EncodeCsv(out, rows[i]);
+        for (size_t e = 0; e < extraCount; ++e) {
+            *out++ = ',';
+            if (e < rows[i].extra.size())
+                out = PutCsvField(out, rows[i].extra[e]);
+        }
+        for (size_t c = 0; c < computedCount; ++c) {
+            *out++ = ',';
+            if (c < valueCount && i < valueRows)
+                out = PutCsvField(out, formulas->GetText(static_cast<int>(i), static_cast<int>(c)));
+        }
+        *out++ = '\n';
+    }
+    chunk.used = static_cast<size_t>(out - start);
+}
+
+std::string FormatCsvHeader(const TableSchema& schema)
+{
+    std::vector<std::wstring> names;
+    for (size_t column = 0; column < schema.GetColumnCount(); ++column)
+        names.push_back(schema.FormatColumnHeader(column));
+    for (const auto& computed : schema.GetComputedColumns())
+        names.push_back(TableSchema::FormatComputedHeader(computed));
+
+    size_t bound = 1;
+    for (const auto& name : names)
+        bound += CsvFieldBound(name);
+
+    std::string header(bound, '\0');
+    char* out = &header[0];
+    for (size_t column = 0; column < names.size(); ++column) {
+        if (column > 0)
+            *out++ = ',';
+        out = PutCsvField(out, names[column]);
+    }
+    *out++ = '\n';
+    header.resize(static_cast<size_t>(out - &header[0]));
+    return header;
+}
+
+//--------------------------------------------------
+// Write CSV rows
+// Chunks are formatted a batch at a time, one per thread,
+// while the previous batch is written out in order, so
+// formatting and disk writes overlap.
+//--------------------------------------------------
+bool WriteCsvRows(AtomicFile& file, const std::vector<DataRow>& rows, const TableSchema& schema,
+                  const FormulaEngine* formulas)
+{
+    bool ok = true;
+    size_t chunks = (rows.size() + kCsvChunkRows - 1) / kCsvChunkRows;
+    size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::max<size_t>(1, std::min(threads, chunks));
+
+    std::vector<CsvChunk> batches[2] = { std::vector<CsvChunk>(threads), std::vector<CsvChunk>(threads) };
+    size_t nextChunk = 0;
+    size_t pendingCount = 0;    // formatted chunks in the other batch, waiting to be written
+    int current = 0;
+
+    while (ok && (nextChunk < chunks || pendingCount > 0)) {
+        size_t count = std::min(threads, chunks - nextChunk);
+
+        std::vector<std::thread> pool;
+        for (size_t t = 0; t < count; ++t) {
+            size_t begin = (nextChunk + t) * kCsvChunkRows;
+            size_t end = std::min(begin + kCsvChunkRows, rows.size());
+            pool.emplace_back(FormatCsvChunk, std::cref(rows), begin, end, std::cref(schema), formulas,
+                std::ref(batches[current][t]));
+        }
+
+        for (size_t t = 0; t < pendingCount && ok; ++t) {
+            const CsvChunk& chunk = batches[1 - current][t];
+            ok = file.Write(chunk.text.data(), chunk.used);
+        }
+
+        for (auto& thread : pool)
+            thread.join();
+
+        pendingCount = count;
+        nextChunk += count;
+        current = 1 - current;
+    }
+
+    return ok;
+}
+
+//--------------------------------------------------
+// Write XLSX
+// forEachRow calls its visitor with every row in order and
+// returns false if the rows could not all be read.
+//--------------------------------------------------
+bool WriteXlsx(const std::wstring& filePath, const TableSchema& schema, const FormulaEngine* formulas,
+               const std::function<bool(const std::function<bool(size_t, const DataRow&)>&)>& forEachRow)
+{
+    // Written beside the target and swapped in once complete
+    std::wstring tempPath = AtomicFile::CreateTempFile(filePath);
+    if (tempPath.empty())
+        return false;
+
+    ZipWriter zip;
+    if (!zip.Open(tempPath)) {
+        AtomicFile::RemoveTemp(tempPath);
+        return false;
+    }
+
+    bool ok = zip.AddEntry("[Content_Types].xml", kContentTypesXml)
+           && zip.AddEntry("_rels/.rels", kRootRelsXml)
+           && zip.AddEntry("xl/workbook.xml", kWorkbookXml)
+           && zip.AddEntry("xl/_rels/workbook.xml.rels", kWorkbookRelsXml)
+           && zip.AddEntry("xl/styles.xml", kStylesXml)
+           && zip.BeginEntry("xl/worksheets/sheet1.xml");
+
+    SharedStringTable strings;
+    std::string buffer;
+    buffer.reserve(kFlushThreshold + 4096);
+    AppendSheetStart(buffer, schema);
+
+    // Header row
+    buffer += "<row r=\"1\">";
+    int columnCount = static_cast<int>(schema.GetColumnCount());
+    for (int column = 0; column < columnCount; column++)
+        AppendStringCell(buffer, strings, column, 1, schema.FormatColumnHeader(column), kHeaderStyle);
+    int computedColumn = columnCount;
+    for (const auto& computed : schema.GetComputedColumns())
+        AppendStringCell(buffer, strings, computedColumn++, 1, TableSchema::FormatComputedHeader(computed), kHeaderStyle);
+    buffer += "</row>";
+
+    // Data rows, flushed to the zip in large pieces
+    if (ok) {
+        bool visited = forEachRow([&](size_t index, const DataRow& row) {
+            AppendDataRow(buffer, strings, index + 2, row, schema, formulas);
+            if (buffer.size() >= kFlushThreshold) {
+                ok = zip.Write(buffer);
+                buffer.clear();
+            }
+            return ok;
+        });
+        ok = ok && visited;
+    }
+
+    buffer += kSheetEndXml;
+    ok = ok && zip.Write(buffer) && zip.EndEntry();
+    buffer.clear();
+
+    // Shared strings are written last, once every string has been seen
+    ok = ok && zip.BeginEntry("xl/sharedStrings.xml");
+    buffer += "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>\n"
+              "<sst xmlns=\"http://schemas.openxmlformats.org/spreadsheetml/2006/main\" count=\"";
+    AppendNumber(buffer, static_cast<double>(strings.References()));
+    buffer += "\" uniqueCount=\"";
+    AppendNumber(buffer, static_cast<double>(strings.Strings().size()));
+    buffer += "\">";
+
+    for (const std::wstring* text : strings.Strings()) {
+        if (!ok)
+            break;
+        buffer += "<si><t xml:space=\"preserve\">";
+        AppendXmlText(buffer, *text);
+        buffer += "</t></si>";
+        if (buffer.size() >= kFlushThreshold) {
+            ok = zip.Write(buffer);
+            buffer.clear();
+        }
+    }
+
+    buffer += "</sst>";
+    ok = ok && zip.Write(buffer) && zip.EndEntry();
+
+    bool closed = zip.Close();
+    if (!ok || !closed) {
+        AtomicFile::RemoveTemp(tempPath);
+        return false;
+    }
+    return AtomicFile::Replace(tempPath, filePath);
+}
+
+} // namespace
+
+//--------------------------------------------------
+// Save CSV
+//--------------------------------------------------
+bool SpreadsheetStorage::SaveToCSV(
+    const std::wstring& filePath,
+    const std::vector<DataRow>& rows,
+    const TableSchema& schema,
+    const FormulaEngine* formulas
+)
+{
+    AtomicFile file;
+    if (!file.Open(filePath))
+        return false;
+
+    // Byte order mark so Excel reads the file as UTF-8
+    std::string header = "\xEF\xBB\xBF" + FormatCsvHeader(schema);
+    bool ok = file.Write(header.data(), header.size())
+           && WriteCsvRows(file, rows, schema, formulas);
+
+    // Flushes to disk and renames over the old file; on failure the old file is kept
+    return ok && file.Commit();
+}
+
+//--------------------------------------------------
+// Save CSV (paged sheet)
+// Rows are read back a block at a time, so only one block
+// is held in memory on top of the store's page cache.
+//--------------------------------------------------
+bool SpreadsheetStorage::SaveToCSV(
+    const std::wstring& filePath,
+    PagedRowStore& rows,
+    const TableSchema& schema
+)
+{
+    AtomicFile file;
+    if (!file.Open(filePath))
+        return false;
+
+    std::string header = "\xEF\xBB\xBF" + FormatCsvHeader(schema);
+    bool ok = file.Write(header.data(), header.size());
+
+    std::vector<DataRow> block;
+    for (size_t offset = 0; ok && rows.GetRows(offset, kPagedBlockRows, block) > 0; offset += block.size())
+        ok = WriteCsvRows(file, block, schema, nullptr);
+
+    return ok && file.Commit();
+}
+
+//--------------------------------------------------
+// Load CSV (paged sheet)
+// Rows are gathered into blocks so onBlock can validate
+// many at once, then appended to the store, which writes
+// full pages out to its backing file.
+//--------------------------------------------------
+bool SpreadsheetStorage::LoadFromCSV(
+    const std::wstring& filePath,
+    PagedRowStore& outRows,
+    TableSchema* outSchema,
+    const std::function<void(std::vector<DataRow>& rows, const std::vector<size_t>& lineNumbers)>& onBlock,
+    std::vector<ImportIssue>* outIssues
+)
+{
+    std::vector<DataRow> block;
+    std::vector<size_t> lineNumbers;
+    bool stored = true;
+
+    auto storeBlock = [&]() {
+        if (onBlock)
+            onBlock(block, lineNumbers);
+        for (size_t i = 0; stored && i < block.size(); i++)
+            stored = outRows.AppendRow(block[i]);
+        block.clear();
+        lineNumbers.clear();
+    };
+
+    bool read = StreamCSV(filePath, [&](const DataRow& row, size_t lineNumber) {
+        block.push_back(row);
+        lineNumbers.push_back(lineNumber);
+        if (block.size() == kPagedBlockRows)
+            storeBlock();
+        return stored;
+    }, outSchema, outIssues);
+
+    if (read && stored && !block.empty())
+        storeBlock();
+    return read && stored;
+}
+
+//--------------------------------------------------
+// Save XLSX
+//--------------------------------------------------
+bool SpreadsheetStorage::SaveToXLSX(
+    const std::wstring& filePath,
+    const std::vector<DataRow>& rows,
+    const TableSchema& schema,
+    const FormulaEngine* formulas
+)
+{
+    return WriteXlsx(filePath, schema, formulas, [&rows](const std::function<bool(size_t, const DataRow&)>& visit) {
+        for (size_t i = 0; i < rows.size(); i++) {
+            if (!visit(i, rows[i]))
+                break;
+        }
+        return true;
+    });
+}
+
+//--------------------------------------------------
+// Save XLSX (paged sheet)
+//--------------------------------------------------
+bool SpreadsheetStorage::SaveToXLSX(
+    const std::wstring& filePath,
+    PagedRowStore& rows,
+    const TableSchema& schema
+)
+{
+    return WriteXlsx(filePath, schema, nullptr, [&rows](const std::function<bool(size_t, const DataRow&)>& visit) {
+        return rows.ForEachRow(visit);
+    });
+}
+
+//--------------------------------------------------
+// Load XLSX
+//--------------------------------------------------
+bool SpreadsheetStorage::LoadFromXLSX(
+    const std::wstring& filePath,
+    std::vector<DataRow>& outRows,
+    TableSchema* outSchema
+)
+{
+    ZipReader zip;
+    if (!zip.Open(filePath))
+        return false;
+
+    std::string sheetPath = FindFirstSheet(zip);
+    if (!zip.HasEntry(sheetPath))
+        return false;
+
+    // Shared strings are needed for lookups while the sheet streams past
+    std::vector<std::wstring> sharedStrings;
+    if (zip.HasEntry("xl/sharedStrings.xml")) {
+        ElementStream stream("si", [&sharedStrings](const std::string& si) {
+            sharedStrings.push_back(CollectText(si, 0, si.size()));
+        });
+        bool ok = zip.ReadEntry("xl/sharedStrings.xml", [&stream](const char* data, size_t size) {
+            return stream.Feed(data, size);
+        });
+        if (!ok)
+            return false;
+    }
+
+    std::vector<bool> currencyStyles = ReadCurrencyStyles(zip);
+
+    outRows.clear();
+    bool headerRead = false;
+    ColumnMapping mapping;
+    std::vector<std::wstring> fields;
+
+    // A number cell's text depends on its column's type, so the number cells of the first rows
+    // are kept until those rows (holding the cells as shown) have settled the types
+    struct NumberCell {
+        size_t row;
+        size_t column;      // schema column
+        double number;
+        bool currency;
+    };
+    std::vector<NumberCell> heldCells, rowCells;
+    bool typed = false;
+
+    auto settleTypes = [&]() {
+        typed = true;
+        mapping.InferTypes(outRows);
+        const TableSchema& schema = mapping.GetSchema();
+        for (const NumberCell& cell : heldCells) {
+            schema.GetField(outRows[cell.row], cell.column)
+                = NumberCellText(cell.number, cell.currency, schema.GetColumn(cell.column).type);
+        }
+        heldCells.clear();
+        heldCells.shrink_to_fit();
+    };
+
+    ElementStream rowStream("row", [&](const std::string& rowXml) {
+        // The header row says which column is which
+        if (!headerRead) {
+            headerRead = true;
+            std::vector<std::wstring> header;
+            ForEachCell(rowXml, sharedStrings, currencyStyles, [&](int column, std::wstring& text, bool, double, bool) {
+                if (static_cast<size_t>(column) >= header.size())
+                    header.resize(column + 1);
+                header[column] = std::move(text);
+            });
+            mapping = ColumnMapping(header);
+            return;
+        }
+
+        const TableSchema& schema = mapping.GetSchema();
+        fields.assign(mapping.GetFileColumnCount(), std::wstring());
+        rowCells.clear();
+        bool hasValue = false;
+
+        ForEachCell(rowXml, sharedStrings, currencyStyles,
+            [&](int column, std::wstring& text, bool isNumber, double number, bool currency) {
+                int schemaColumn = mapping.GetSchemaColumn(column);
+                if (schemaColumn < 0)
+                    return;
+                if (isNumber && typed) {
+                    text = NumberCellText(number, currency, schema.GetColumn(schemaColumn).type);
+                } else if (isNumber) {
+                    text = NumberCellText(number, currency, ColumnType::Text);
+                    rowCells.push_back({ outRows.size(), static_cast<size_t>(schemaColumn), number, currency });
+                }
+                fields[column] = std::move(text);
+                hasValue = true;
+            });
+
+        DataRow row;
+        if (hasValue && mapping.Decode(fields, row)) {
+            outRows.push_back(std::move(row));
+            if (!typed) {
+                heldCells.insert(heldCells.end(), rowCells.begin(), rowCells.end());
+                if (outRows.size() == ColumnMapping::kTypeSampleRows)
+                    settleTypes();
+            }
+        }
+    });
+
+    bool ok = zip.ReadEntry(sheetPath, [&rowStream](const char* data, size_t size) {
+        return rowStream.Feed(data, size);
+    });
+    if (!typed)
+        settleTypes();
+    if (outSchema)
+        *outSchema = mapping.GetSchema();
+    return ok;
+}
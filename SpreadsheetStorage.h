@@ -5,124 +5,305 @@
 #include <fstream>
 #include <sstream>
 #include <algorithm>
-#include "DataTable.h"   // for DataRow
+#include <functional>
+#include "DataRow.h"
+#include "TableSchema.h"
+#include "TextEncoding.h"
+
+class FormulaEngine;
+class PagedRowStore;
 
 class SpreadsheetStorage {
 public:
-    // Save rows to CSV file
+    // Save rows to CSV file (UTF-8). Rows are formatted in parallel and the file is
+    // replaced atomically, so a failed save leaves the previous file untouched.
+    // The header row and column order come from the schema. Computed columns are written
+    // after the stored ones, with their values taken from formulas when it is given.
+    static bool SaveToCSV(
+        const std::wstring& filePath,
+        const std::vector<DataRow>& rows,
+        const TableSchema& schema = TableSchema::CostTracker(),
+        const FormulaEngine* formulas = nullptr
+    );
+
+    // Save a sheet held in a PagedRowStore, reading it back a block at a time.
+    // Computed columns get their header but no values (they are not calculated for paged sheets).
     static bool SaveToCSV(
         const std::wstring& filePath,
-        const std::vector<DataRow>& rows
+        PagedRowStore& rows,
+        const TableSchema& schema
+    );
+
+    // Read a CSV file one row at a time without keeping the rows.
+    // Used for sheets too large to hold in memory (see PagedRowStore).
+    // Columns are matched to the schema by the header row, and extra columns the
+    // header gives no type are typed from the first rows (ColumnMapping::InferTypes).
+    // outSchema (optional) receives the resulting schema before the first row is
+    // delivered. Return false from the callback to stop early. outIssues (optional)
+    // receives problems with the file's layout, such as a quoted field that is never closed.
+    static bool StreamCSV(
+        const std::wstring& filePath,
+        const std::function<bool(const DataRow& row, size_t lineNumber)>& onRow,
+        TableSchema* outSchema = nullptr,
+        std::vector<ImportIssue>* outIssues = nullptr
     )
     {
-        std::wofstream file(filePath);
+        std::ifstream file;
+        OpenFileStream(file, filePath, std::ios::in | std::ios::binary);
         if (!file.is_open())
             return false;
 
-        // Optional header row
-        file << L"Category,Item,Material,Description,Quantity,Unit Cost,Cost,Notes\n";
-
-        for (const auto& row : rows) {
-            file
-                << Escape(row.category)    << L","
-                << Escape(row.item)        << L","
-                << Escape(row.material)    << L","
-                << Escape(row.description) << L","
-                << Escape(row.quantity)    << L","
-                << Escape(row.unitCost)    << L","
-                << Escape(row.cost)        << L","
-                << Escape(row.notes)
-                << L"\n";
+        std::string bytes;
+        std::wstring line;
+        size_t lineNumber = 1;
+
+        // Header
+        ColumnMapping mapping;
+        size_t lineCount = 0;
+        if (ReadCSVRecord(file, bytes, lineCount)) {
+            lineNumber += lineCount - 1;
+            if (bytes.compare(0, 3, "\xEF\xBB\xBF") == 0)
+                bytes.erase(0, 3);
+            AppendTextLine(line, bytes.data(), bytes.size());
+            mapping = ColumnMapping(ParseCSVLine(line));
         }
 
+        // The first rows are held back until they have settled the column types
+        std::vector<DataRow> sample;
+        std::vector<size_t> sampleLines;
+        bool typed = false;
+        auto settleTypes = [&]() {
+            typed = true;
+            mapping.InferTypes(sample);
+            if (outSchema)
+                *outSchema = mapping.GetSchema();
+            for (size_t i = 0; i < sample.size(); i++) {
+                if (!onRow(sample[i], sampleLines[i]))
+                    return false;
+            }
+            return true;
+        };
+
+        DataRow row;
+        bool more = true;
+        while (more && ReadCSVRecord(file, bytes, lineCount)) {
+            size_t recordLine = lineNumber + 1;
+            lineNumber += lineCount;
+
+            line.clear();
+            AppendTextLine(line, bytes.data(), bytes.size());
+            int unclosedField = -1;
+            std::vector<std::wstring> fields = ParseCSVLine(line, &unclosedField);
+            if (unclosedField >= 0 && outIssues)
+                outIssues->push_back(UnclosedQuoteIssue(mapping, unclosedField, recordLine));
+            if (!mapping.Decode(fields, row))
+                continue;
+
+            if (typed) {
+                more = onRow(row, recordLine);
+            } else {
+                sample.push_back(row);
+                sampleLines.push_back(recordLine);
+                if (sample.size() == ColumnMapping::kTypeSampleRows)
+                    more = settleTypes();
+            }
+        }
+
+        if (!typed)
+            settleTypes();
         return true;
     }
 
-    // Load rows from CSV file
+    // Load rows from CSV file. outLineNumbers (optional) receives the
+    // file line each row came from, for error reporting.
     static bool LoadFromCSV(
         const std::wstring& filePath,
-        std::vector<DataRow>& outRows
+        std::vector<DataRow>& outRows,
+        std::vector<size_t>* outLineNumbers = nullptr,
+        TableSchema* outSchema = nullptr,
+        std::vector<ImportIssue>* outIssues = nullptr
     )
     {
-        std::wifstream file(filePath);
-        if (!file.is_open())
-            return false;
-
         outRows.clear();
+        if (outLineNumbers)
+            outLineNumbers->clear();
 
-        std::wstring line;
+        return StreamCSV(filePath, [&](const DataRow& row, size_t lineNumber) {
+            outRows.push_back(row);
+            if (outLineNumbers)
+                outLineNumbers->push_back(lineNumber);
+            return true;
+        }, outSchema, outIssues);
+    }
 
-        // Skip header
-        std::getline(file, line);
+    // Load a CSV file into a PagedRowStore opened by the caller, for sheets too large to hold in memory.
+    // onBlock (optional) receives each block of rows, with the file line of each one, before the block
+    // is stored, so the rows can be checked and tidied on the way in.
+    static bool LoadFromCSV(
+        const std::wstring& filePath,
+        PagedRowStore& outRows,
+        TableSchema* outSchema = nullptr,
+        const std::function<void(std::vector<DataRow>& rows, const std::vector<size_t>& lineNumbers)>& onBlock = nullptr,
+        std::vector<ImportIssue>* outIssues = nullptr
+    );
 
-        while (std::getline(file, line)) {
-            std::vector<std::wstring> fields = ParseCSVLine(line);
-            if (fields.size() != 8)
-                continue;
+    // Save rows to an Excel workbook (.xlsx). Rows are streamed into the
+    // sheet so memory use does not grow with the row count.
+    static bool SaveToXLSX(
+        const std::wstring& filePath,
+        const std::vector<DataRow>& rows,
+        const TableSchema& schema = TableSchema::CostTracker(),
+        const FormulaEngine* formulas = nullptr
+    );
 
-            DataRow row;
-            row.category    = fields[0];
-            row.item        = fields[1];
-            row.material    = fields[2];
-            row.description = fields[3];
-            row.quantity    = fields[4];
-            row.unitCost    = fields[5];
-            row.cost        = fields[6];
-            row.notes       = fields[7];
+    // Save a sheet held in a PagedRowStore to an Excel workbook, one page at a time
+    static bool SaveToXLSX(
+        const std::wstring& filePath,
+        PagedRowStore& rows,
+        const TableSchema& schema
+    );
 
-            outRows.push_back(row);
-        }
+    // Load rows from the first worksheet of an Excel workbook (.xlsx).
+    // Columns are matched to the schema by the header row, as for CSV. Extra columns the header
+    // gives no type are typed from the first rows' cells as the sheet shows them, so a number
+    // with a currency format counts as an amount.
+    static bool LoadFromXLSX(
+        const std::wstring& filePath,
+        std::vector<DataRow>& outRows,
+        TableSchema* outSchema = nullptr
+    );
 
-        return true;
+    // Lines one CSV record may span. A quote still open after this many (or at the end of the
+    // file) is taken as a stray one, so it cannot swallow the rest of the file.
+    static constexpr size_t kMaxRecordLines = 100;
+
+    // How far a CSV record has been read. A quote opens a quoted field only as the field's
+    // first character, so one inside an unquoted value (2" pipe) is plain text.
+    enum class CSVQuoteState { FieldStart, Unquoted, Quoted, QuoteInQuoted };
+
+    // Carry the state over some bytes of a record. A line break read in the Quoted
+    // state belongs to the field; in any other state it ends the record.
+    static CSVQuoteState ScanCSVQuotes(const char* begin, const char* end, CSVQuoteState state)
+    {
+        for (const char* p = begin; p < end; p++) {
+            char ch = *p;
+            switch (state) {
+            case CSVQuoteState::FieldStart:
+                state = ch == '"' ? CSVQuoteState::Quoted : ch == ',' ? CSVQuoteState::FieldStart : CSVQuoteState::Unquoted;
+                break;
+            case CSVQuoteState::Unquoted:
+                if (ch == ',')
+                    state = CSVQuoteState::FieldStart;
+                break;
+            case CSVQuoteState::Quoted:
+                if (ch == '"')
+                    state = CSVQuoteState::QuoteInQuoted;
+                break;
+            case CSVQuoteState::QuoteInQuoted:   // "" is an escaped quote; anything else closed the field
+                state = ch == '"' ? CSVQuoteState::Quoted : ch == ',' ? CSVQuoteState::FieldStart : CSVQuoteState::Unquoted;
+                break;
+            }
+        }
+        return state;
     }
 
-private:
-    // Escape CSV fields that contain commas or quotes
-    static std::wstring Escape(const std::wstring& field)
+    // Read one CSV record, without its line ending. A quoted field may hold line breaks,
+    // so lines are joined while one is open; lineCount receives the lines used. If the quote
+    // is not closed within kMaxRecordLines lines, the record is just its first line and
+    // ParseCSVLine reports the open quote.
+    static bool ReadCSVRecord(std::istream& file, std::string& bytes, size_t& lineCount)
     {
-        if (field.find(L',') == std::wstring::npos &&
-            field.find(L'"') == std::wstring::npos)
-            return field;
-
-        std::wstring escaped = L"\"";
-        for (wchar_t ch : field) {
-            if (ch == L'"')
-                escaped += L"\"\"";
-            else
-                escaped += ch;
+        if (!std::getline(file, bytes))
+            return false;
+        lineCount = 1;
+
+        CSVQuoteState state = ScanCSVQuotes(bytes.data(), bytes.data() + bytes.size(), CSVQuoteState::FieldStart);
+        if (state == CSVQuoteState::Quoted) {
+            std::streampos secondLine = file.tellg();
+            size_t firstLength = bytes.size();
+            std::string next;
+
+            while (state == CSVQuoteState::Quoted && lineCount < kMaxRecordLines && std::getline(file, next)) {
+                bytes += '\n';
+                bytes += next;
+                lineCount++;
+                state = ScanCSVQuotes(next.data(), next.data() + next.size(), state);
+            }
+
+            if (state == CSVQuoteState::Quoted) {
+                bytes.resize(firstLength);
+                lineCount = 1;
+                file.clear();
+                file.seekg(secondLine);
+            }
         }
-        escaped += L"\"";
-        return escaped;
+
+        if (!bytes.empty() && bytes.back() == '\r')
+            bytes.pop_back();
+        return true;
     }
 
-    // Parse a CSV line into fields
-    static std::vector<std::wstring> ParseCSVLine(const std::wstring& line)
+    // Parse a CSV line into fields, with the same quoting rules as ScanCSVQuotes. A quote that is
+    // never closed is kept as text, and outUnclosedField (optional) receives that field's index
+    // (-1 if every quote was closed).
+    static std::vector<std::wstring> ParseCSVLine(const std::wstring& line, int* outUnclosedField = nullptr)
     {
         std::vector<std::wstring> result;
         std::wstring field;
         bool inQuotes = false;
+        bool fieldStart = true;
+        size_t openedAt = 0;    // position of the opening quote while inQuotes
+        size_t literalQuote = std::wstring::npos;
+
+        if (outUnclosedField)
+            *outUnclosedField = -1;
 
         for (size_t i = 0; i < line.size(); i++) {
             wchar_t ch = line[i];
 
-            if (ch == L'"') {
-                if (inQuotes && i + 1 < line.size() && line[i + 1] == L'"') {
+            if (ch == L'"' && fieldStart && i != literalQuote) {
+                inQuotes = true;
+                openedAt = i;
+            }
+            else if (ch == L'"' && inQuotes) {
+                if (i + 1 < line.size() && line[i + 1] == L'"') {
                     field += L'"';
                     i++;
                 } else {
-                    inQuotes = !inQuotes;
+                    inQuotes = false;
                 }
             }
             else if (ch == L',' && !inQuotes) {
                 result.push_back(field);
                 field.clear();
+                fieldStart = true;
+                continue;
             }
             else {
                 field += ch;
             }
+            fieldStart = false;
+
+            // Never closed: go back and read the field again with its quote as text
+            if (inQuotes && i + 1 == line.size()) {
+                if (outUnclosedField)
+                    *outUnclosedField = static_cast<int>(result.size());
+                inQuotes = false;
+                field.clear();
+                fieldStart = true;
+                literalQuote = openedAt;
+                i = openedAt - 1;
+            }
         }
 
         result.push_back(field);
         return result;
     }
+
+    // The problem reported for a record whose field (a file column) has a quote that is never closed
+    static ImportIssue UnclosedQuoteIssue(const ColumnMapping& mapping, int field, size_t line)
+    {
+        return { line, mapping.GetSchemaColumn(static_cast<size_t>(field)),
+                 L"Quoted field is never closed; the quote was read as text" };
+    }
 };
@@ -0,0 +1,349 @@
+//Implementation file for TableSchema and ColumnMapping classes
+
+#include "TableSchema.h"
+#include <algorithm>
+#include <cwctype>
+
+namespace {
+
+const std::wstring DataRow::* const kBuiltInFields[] = {
+    &DataRow::category, &DataRow::item, &DataRow::material, &DataRow::description,
+    &DataRow::quantity, &DataRow::unitCost, &DataRow::cost, &DataRow::notes
+};
+
+const size_t kBuiltInCount = CostTrackerSchema::kColumnCount;
+
+static_assert(sizeof(kBuiltInFields) / sizeof(kBuiltInFields[0]) == kBuiltInCount,
+    "built-in field list must match CostTrackerSchema");
+
+// Width of list view columns for extra columns
+const int kExtraColumnWidth = 120;
+
+std::wstring Trim(const std::wstring& text)
+{
+    size_t begin = 0, end = text.size();
+    while (begin < end && std::iswspace(text[begin]))
+        begin++;
+    while (end > begin && std::iswspace(text[end - 1]))
+        end--;
+    return text.substr(begin, end - begin);
+}
+
+std::wstring Normalize(const std::wstring& name)
+{
+    std::wstring result = Trim(name);
+    for (auto& ch : result)
+        ch = static_cast<wchar_t>(std::towlower(ch));
+    return result;
+}
+
+// "Name [annotation]" -> name and annotation; false if the header has no annotation
+bool SplitAnnotation(const std::wstring& header, std::wstring& outName, std::wstring& outAnnotation)
+{
+    std::wstring text = Trim(header);
+    size_t open = text.rfind(L'[');
+    if (text.empty() || text.back() != L']' || open == std::wstring::npos)
+        return false;
+
+    outName = Trim(text.substr(0, open));
+    outAnnotation = Trim(text.substr(open + 1, text.size() - open - 2));
+    return !outName.empty() && !outAnnotation.empty();
+}
+
+const wchar_t* const kTypeAnnotations[] = { L"text", L"number", L"money" };    // in ColumnType order
+const wchar_t kOptionalAnnotation[] = L"optional";
+
+bool ParseTypeAnnotation(const std::wstring& annotation, ColumnType& outType)
+{
+    std::wstring key = Normalize(annotation);
+    for (size_t i = 0; i < sizeof(kTypeAnnotations) / sizeof(kTypeAnnotations[0]); i++) {
+        if (key == kTypeAnnotations[i]) {
+            outType = static_cast<ColumnType>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool IsBlank(const std::wstring& text)
+{
+    for (wchar_t ch : text) {
+        if (!std::iswspace(ch))
+            return false;
+    }
+    return true;
+}
+
+} // namespace
+
+//--------------------------------------------------
+// TableSchema
+//--------------------------------------------------
+TableSchema::TableSchema()
+    : columns{
+        { L"Category",    ColumnType::Text,   100, true,  false },
+        { L"Item",        ColumnType::Text,   120, true,  false },
+        { L"Material",    ColumnType::Text,   120, true,  false },
+        { L"Description", ColumnType::Text,   200, true,  false },
+        { L"Quantity",    ColumnType::Number,  70, true,  true  },
+        { L"Unit Cost",   ColumnType::Money,   90, true,  true  },
+        { L"Cost",        ColumnType::Money,   90, false, true  },
+        { L"Notes",       ColumnType::Text,   200, true,  false },
+    }
+{
+}
+
+const TableSchema& TableSchema::CostTracker() {
+    static const TableSchema schema;
+    return schema;
+}
+
+size_t TableSchema::GetColumnCount() const {
+    return columns.size();
+}
+
+size_t TableSchema::GetExtraCount() const {
+    return columns.size() - kBuiltInCount;
+}
+
+const ColumnInfo& TableSchema::GetColumn(size_t column) const {
+    return columns[column];
+}
+
+int TableSchema::FindColumn(const std::wstring& name) const {
+    std::wstring key = Normalize(name);
+    for (size_t i = 0; i < columns.size(); i++) {
+        if (Normalize(columns[i].name) == key)
+            return static_cast<int>(i);
+    }
+    return -1;
+}
+
+void TableSchema::AddColumn(const std::wstring& name, ColumnType type) {
+    columns.push_back({ name, type, kExtraColumnWidth, true, false });
+}
+
+void TableSchema::SetColumnType(size_t column, ColumnType type) {
+    if (column >= kBuiltInCount && column < columns.size())
+        columns[column].type = type;
+}
+
+void TableSchema::SetRequired(size_t column, bool required) {
+    if (column < columns.size())
+        columns[column].required = required;
+}
+
+std::wstring TableSchema::FormatColumnHeader(size_t column) const {
+    const ColumnInfo& info = columns[column];
+    if (column < kBuiltInCount) {
+        bool optional = CostTracker().columns[column].required && !info.required;
+        return optional ? info.name + L" [" + kOptionalAnnotation + L"]" : info.name;
+    }
+    if (info.type == ColumnType::Text)
+        return info.name;
+    return info.name + L" [" + kTypeAnnotations[static_cast<size_t>(info.type)] + L"]";
+}
+
+void TableSchema::AddComputedColumn(const std::wstring& name, const std::wstring& formula) {
+    computed.push_back({ name, formula });
+}
+
+void TableSchema::ClearComputedColumns() {
+    computed.clear();
+}
+
+const std::vector<ComputedColumn>& TableSchema::GetComputedColumns() const {
+    return computed;
+}
+
+std::wstring TableSchema::FormatComputedHeader(const ComputedColumn& column) {
+    return column.name + L" [= " + column.formula + L"]";
+}
+
+const std::wstring& TableSchema::GetField(const DataRow& row, size_t column) const {
+    static const std::wstring empty;
+    if (column < kBuiltInCount)
+        return row.*kBuiltInFields[column];
+    size_t extra = column - kBuiltInCount;
+    return extra < row.extra.size() ? row.extra[extra] : empty;
+}
+
+std::wstring& TableSchema::GetField(DataRow& row, size_t column) const {
+    if (column < kBuiltInCount)
+        return const_cast<std::wstring&>(row.*kBuiltInFields[column]);
+    size_t extra = column - kBuiltInCount;
+    if (extra >= row.extra.size())
+        row.extra.resize(extra + 1);
+    return row.extra[extra];
+}
+
+bool TableSchema::ParseValue(const DataRow& row, size_t column, double& out) const {
+    switch (columns[column].type) {
+        case ColumnType::Number: return ParseColumnValue<ColumnType::Number>(GetField(row, column), out);
+        case ColumnType::Money:  return ParseColumnValue<ColumnType::Money>(GetField(row, column), out);
+        default:                 return false;
+    }
+}
+
+bool TableSchema::operator==(const TableSchema& other) const {
+    if (columns.size() != other.columns.size() || computed.size() != other.computed.size())
+        return false;
+    for (size_t i = 0; i < columns.size(); i++) {
+        if (columns[i].name != other.columns[i].name || columns[i].type != other.columns[i].type
+            || columns[i].required != other.columns[i].required)
+            return false;
+    }
+    for (size_t i = 0; i < computed.size(); i++) {
+        if (computed[i].name != other.computed[i].name || computed[i].formula != other.computed[i].formula)
+            return false;
+    }
+    return true;
+}
+
+bool TableSchema::operator!=(const TableSchema& other) const {
+    return !(*this == other);
+}
+
+//--------------------------------------------------
+// ColumnMapping
+//--------------------------------------------------
+ColumnMapping::ColumnMapping() {
+    for (size_t i = 0; i < kBuiltInCount; i++)
+        schemaColumns.push_back(static_cast<int>(i));
+}
+
+ColumnMapping::ColumnMapping(const std::vector<std::wstring>& header) {
+    std::vector<bool> used(kBuiltInCount, false);
+    std::vector<bool> skipped(header.size(), false);
+    schemaColumns.assign(header.size(), -1);
+
+    // Names with any type or optional annotation taken off
+    std::vector<std::wstring> names(header);
+    std::vector<ColumnType> types(header.size(), ColumnType::Text);
+    std::vector<bool> typed(header.size(), false);
+    std::vector<bool> optional(header.size(), false);
+
+    bool anyMatch = false;
+    for (size_t i = 0; i < header.size(); i++) {
+        // Computed columns are recalculated after loading, so their saved values are not read
+        std::wstring name, annotation;
+        if (SplitAnnotation(header[i], name, annotation)) {
+            if (annotation[0] == L'=') {
+                schema.AddComputedColumn(name, Trim(annotation.substr(1)));
+                skipped[i] = true;
+                continue;
+            }
+            if (ParseTypeAnnotation(annotation, types[i])) {
+                names[i] = name;
+                typed[i] = true;
+            } else if (Normalize(annotation) == kOptionalAnnotation) {
+                names[i] = name;
+                optional[i] = true;
+            }
+        }
+
+        int column = TableSchema::CostTracker().FindColumn(names[i]);
+        if (column >= 0 && !used[column]) {
+            used[column] = true;
+            schemaColumns[i] = column;
+            anyMatch = true;
+            if (optional[i])
+                schema.SetRequired(static_cast<size_t>(column), false);
+        }
+    }
+
+    // A sheet with its own columns has no values to check in the built-in columns it lacks
+    if (anyMatch) {
+        for (size_t column = 0; column < kBuiltInCount; column++) {
+            if (!used[column])
+                schema.SetRequired(column, false);
+        }
+    }
+
+    // No recognisable header: the built-in columns by position, as files were always read
+    if (!anyMatch) {
+        schemaColumns.resize(std::max(header.size(), kBuiltInCount), -1);
+        skipped.resize(schemaColumns.size(), false);
+        size_t next = 0;
+        for (size_t i = 0; i < schemaColumns.size() && next < kBuiltInCount; i++) {
+            if (!skipped[i])
+                schemaColumns[i] = static_cast<int>(next++);
+        }
+    }
+
+    for (size_t i = 0; i < schemaColumns.size(); i++) {
+        if (schemaColumns[i] >= 0 || skipped[i])
+            continue;
+        std::wstring name = i < names.size() ? names[i] : std::wstring();
+        if (Normalize(name).empty())
+            name = L"Column " + std::to_wstring(i + 1);
+        schemaColumns[i] = static_cast<int>(schema.GetColumnCount());
+        if (i < typed.size() && typed[i]) {
+            schema.AddColumn(name, types[i]);
+        } else {
+            untypedColumns.push_back(schema.GetColumnCount());
+            schema.AddColumn(name);
+        }
+    }
+
+    builtInOrder = schemaColumns.size() == kBuiltInCount;
+    for (size_t i = 0; builtInOrder && i < schemaColumns.size(); i++)
+        builtInOrder = schemaColumns[i] == static_cast<int>(i);
+}
+
+void ColumnMapping::InferTypes(const std::vector<DataRow>& sample) {
+    size_t sampleRows = std::min(sample.size(), kTypeSampleRows);
+
+    for (size_t column : untypedColumns) {
+        bool anyValue = false, allNumbers = true, allAmounts = true, anyCurrency = false;
+        for (size_t i = 0; i < sampleRows && (allNumbers || allAmounts); i++) {
+            const std::wstring& text = schema.GetField(sample[i], column);
+            if (IsBlank(text))
+                continue;
+
+            double value;
+            anyValue = true;
+            allNumbers = allNumbers && ImportValidator::ParseNumber(text, value, false);
+            allAmounts = allAmounts && ImportValidator::ParseNumber(text, value, true);
+            anyCurrency = anyCurrency || text.find(L'$') != std::wstring::npos;
+        }
+
+        if (anyValue && allNumbers)
+            schema.SetColumnType(column, ColumnType::Number);
+        else if (anyValue && allAmounts && anyCurrency)
+            schema.SetColumnType(column, ColumnType::Money);
+    }
+    untypedColumns.clear();
+}
+
+const TableSchema& ColumnMapping::GetSchema() const {
+    return schema;
+}
+
+size_t ColumnMapping::GetFileColumnCount() const {
+    return schemaColumns.size();
+}
+
+int ColumnMapping::GetSchemaColumn(size_t fileColumn) const {
+    return fileColumn < schemaColumns.size() ? schemaColumns[fileColumn] : -1;
+}
+
+bool ColumnMapping::Decode(std::vector<std::wstring>& fields, DataRow& out) const {
+    if (fields.size() != schemaColumns.size())
+        return false;
+
+    if (builtInOrder) {
+        CostTrackerSchema::Decode(fields, out);
+        out.extra.clear();
+        return true;
+    }
+
+    // Columns missing from the file stay empty
+    out = DataRow();
+    out.extra.resize(schema.GetExtraCount());
+    for (size_t i = 0; i < fields.size(); i++) {
+        if (schemaColumns[i] >= 0)
+            schema.GetField(out, static_cast<size_t>(schemaColumns[i])) = std::move(fields[i]);
+    }
+    return true;
+}
@@ -0,0 +1,296 @@
+//Header for the table schema types. The purpose of these types is to describe the columns of a sheet in one place
+//and derive everything else from that description: the list view columns, the entry dialog, the CSV and XLSX
+//readers and writers, and totals.
+//
+//The built-in cost tracker columns are a compile-time FixedSchema. Its decode, encode and parse functions are
+//generated per column with fold expressions, so the common case compiles down to straight-line code with no
+//lookups. Sheets with other columns get a runtime TableSchema built from their header row: known names map onto
+//the built-in columns and anything else becomes an extra column, kept in DataRow::extra.
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "DataRow.h"
+#include "ImportValidator.h"
+
+enum class ColumnType { Text, Number, Money };
+
+struct ColumnInfo {
+    std::wstring name;
+    ColumnType type;
+    int width;          // list view width in pixels
+    bool editable;      // shown in the entry dialog (Cost is calculated instead)
+    bool required;      // an empty value is reported on import
+};
+
+// A column calculated by FormulaEngine. Saved files keep it as a header annotation, "Name [= formula]",
+// followed by its values; loading reads the formula back and ignores the saved values.
+struct ComputedColumn {
+    std::wstring name;
+    std::wstring formula;
+};
+
+//--------------------------------------------------
+// Field codecs shared by every schema
+//--------------------------------------------------
+
+// Most UTF-8 bytes one wchar_t can need (a UTF-16 surrogate half needs 2 units for 4 bytes)
+const size_t kMaxUtf8PerChar = sizeof(wchar_t) == 2 ? 3 : 4;
+
+// Worst-case bytes PutCsvField writes for a field, plus its separator: two quotes, and a doubled
+// quote still fits in the per-character allowance
+inline size_t CsvFieldBound(const std::wstring& field)
+{
+    return field.size() * kMaxUtf8PerChar + 3;
+}
+
+inline char* PutUtf8(char* out, unsigned long cp)
+{
+    if (cp < 0x800) {
+        *out++ = static_cast<char>(0xC0 | (cp >> 6));
+    } else if (cp < 0x10000) {
+        *out++ = static_cast<char>(0xE0 | (cp >> 12));
+        *out++ = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+    } else {
+        *out++ = static_cast<char>(0xF0 | (cp >> 18));
+        *out++ = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        *out++ = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+    }
+    *out++ = static_cast<char>(0x80 | (cp & 0x3F));
+    return out;
+}
+
+// Write one field as UTF-8, quoted if it holds a comma, quote or line break, straight into a buffer
+// sized with CsvFieldBound
+inline char* PutCsvField(char* out, const std::wstring& field)
+{
+    const wchar_t* p = field.data();
+    const wchar_t* end = p + field.size();
+
+    bool quote = false;
+    for (const wchar_t* q = p; q < end; ++q) {
+        if (*q == L',' || *q == L'"' || *q == L'\n' || *q == L'\r') {
+            quote = true;
+            break;
+        }
+    }
+
+    if (quote)
+        *out++ = '"';
+
+    for (; p < end; ++p) {
+        unsigned long cp = static_cast<unsigned long>(*p);
+        if (cp < 0x80) {
+            if (cp == '"')
+                *out++ = '"';
+            *out++ = static_cast<char>(cp);
+            continue;
+        }
+        if (cp >= 0xD800 && cp <= 0xDBFF && p + 1 < end &&
+            static_cast<unsigned long>(p[1]) >= 0xDC00 && static_cast<unsigned long>(p[1]) <= 0xDFFF) {
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (static_cast<unsigned long>(p[1]) - 0xDC00);
+            ++p;
+        }
+        out = PutUtf8(out, cp);
+    }
+
+    if (quote)
+        *out++ = '"';
+    return out;
+}
+
+template <ColumnType Type>
+inline bool ParseColumnValue(const std::wstring& text, double& out)
+{
+    if constexpr (Type == ColumnType::Number)
+        return ImportValidator::ParseNumber(text, out, false);
+    else if constexpr (Type == ColumnType::Money)
+        return ImportValidator::ParseNumber(text, out, true);
+    else
+        return false;
+}
+
+//--------------------------------------------------
+// Compile-time schema
+//--------------------------------------------------
+
+// One column stored in a DataRow member
+template <std::wstring DataRow::* Member, ColumnType Type>
+struct FixedColumn {
+    static constexpr ColumnType type = Type;
+
+    static const std::wstring& Get(const DataRow& row) { return row.*Member; }
+    static std::wstring& Get(DataRow& row) { return row.*Member; }
+};
+
+template <typename... Columns>
+struct FixedSchema {
+    static constexpr size_t kColumnCount = sizeof...(Columns);
+
+    template <size_t Index>
+    using Column = std::tuple_element_t<Index, std::tuple<Columns...>>;
+
+    // Move parsed fields into a row. The caller has checked fields.size() == kColumnCount.
+    static void Decode(std::vector<std::wstring>& fields, DataRow& out)
+    {
+        DecodeColumns(fields, out, std::index_sequence_for<Columns...>());
+    }
+
+    static size_t CsvBound(const DataRow& row)
+    {
+        return (CsvFieldBound(Columns::Get(row)) + ...);
+    }
+
+    // Comma-separated fields with no line ending
+    static char* EncodeCsv(char* out, const DataRow& row)
+    {
+        bool first = true;
+        ((out = PutSeparated(out, Columns::Get(row), first)), ...);
+        return out;
+    }
+
+    template <size_t Index>
+    static bool Parse(const DataRow& row, double& out)
+    {
+        using C = Column<Index>;
+        return ParseColumnValue<C::type>(C::Get(row), out);
+    }
+
+    // visit(columnIndex, text) for every column in order
+    template <typename Visitor>
+    static void ForEach(const DataRow& row, Visitor&& visit)
+    {
+        ForEachColumn(row, visit, std::index_sequence_for<Columns...>());
+    }
+
+    template <typename Visitor>
+    static void ForEach(DataRow& row, Visitor&& visit)
+    {
+        ForEachColumn(row, visit, std::index_sequence_for<Columns...>());
+    }
+
+private:
+    template <size_t... I>
+    static void DecodeColumns(std::vector<std::wstring>& fields, DataRow& out, std::index_sequence<I...>)
+    {
+        ((Columns::Get(out) = std::move(fields[I])), ...);
+    }
+
+    template <typename Row, typename Visitor, size_t... I>
+    static void ForEachColumn(Row& row, Visitor& visit, std::index_sequence<I...>)
+    {
+        (visit(I, Columns::Get(row)), ...);
+    }
+
+    static char* PutSeparated(char* out, const std::wstring& field, bool& first)
+    {
+        if (!first)
+            *out++ = ',';
+        first = false;
+        return PutCsvField(out, field);
+    }
+};
+
+// The cost tracker's own columns, in file order
+struct CostTrackerColumns {
+    enum : size_t { Category, Item, Material, Description, Quantity, UnitCost, Cost, Notes };
+};
+
+using CostTrackerSchema = FixedSchema<
+    FixedColumn<&DataRow::category,    ColumnType::Text>,
+    FixedColumn<&DataRow::item,        ColumnType::Text>,
+    FixedColumn<&DataRow::material,    ColumnType::Text>,
+    FixedColumn<&DataRow::description, ColumnType::Text>,
+    FixedColumn<&DataRow::quantity,    ColumnType::Number>,
+    FixedColumn<&DataRow::unitCost,    ColumnType::Money>,
+    FixedColumn<&DataRow::cost,        ColumnType::Money>,
+    FixedColumn<&DataRow::notes,       ColumnType::Text>
+>;
+
+//--------------------------------------------------
+// Runtime schema
+//--------------------------------------------------
+class TableSchema {
+public:
+    // The built-in cost tracker columns and no extras
+    TableSchema();
+    static const TableSchema& CostTracker();
+
+    size_t GetColumnCount() const;
+    size_t GetExtraCount() const;           // columns after the built-in ones
+    const ColumnInfo& GetColumn(size_t column) const;
+
+    // Case-insensitive, surrounding spaces ignored; -1 if there is no such column
+    int FindColumn(const std::wstring& name) const;
+
+    // Append an extra column (stored in DataRow::extra)
+    void AddColumn(const std::wstring& name, ColumnType type = ColumnType::Text);
+    void SetColumnType(size_t column, ColumnType type);     // extra columns only
+    void SetRequired(size_t column, bool required);
+
+    // Header text of a stored column in a saved file. Extra Number and Money columns carry their
+    // type ("Supplier Price [money]"), and built-in columns the sheet does without are marked
+    // "[optional]", so a reloaded sheet checks its values the same way.
+    std::wstring FormatColumnHeader(size_t column) const;
+
+    // Computed columns follow the stored ones in the list view and in saved files
+    void AddComputedColumn(const std::wstring& name, const std::wstring& formula);
+    void ClearComputedColumns();
+    const std::vector<ComputedColumn>& GetComputedColumns() const;
+
+    // Header text of a computed column in a saved file
+    static std::wstring FormatComputedHeader(const ComputedColumn& column);
+
+    const std::wstring& GetField(const DataRow& row, size_t column) const;
+    std::wstring& GetField(DataRow& row, size_t column) const;     // grows row.extra when needed
+    bool ParseValue(const DataRow& row, size_t column, double& out) const;
+
+    bool operator==(const TableSchema& other) const;
+    bool operator!=(const TableSchema& other) const;
+
+private:
+    std::vector<ColumnInfo> columns;
+    std::vector<ComputedColumn> computed;
+};
+
+// How the columns of one file line up with a schema, worked out from the file's header row
+class ColumnMapping {
+public:
+    // A file whose columns are exactly the built-in ones, in order
+    ColumnMapping();
+
+    // Header names that match a built-in column (in any order) are mapped to it; the rest become
+    // extra columns. If no name matches at all, the first columns are taken as the built-in ones
+    // by position, as older files without a proper header were read. Computed column headers
+    // ("Name [= formula]") go into the schema's computed columns and their values are skipped.
+    // Built-in columns missing from a matched header are not required. A header annotation
+    // ("Name [text]", "[number]", "[money]" or "[optional]") sets an extra column's type or marks
+    // a built-in column optional.
+    explicit ColumnMapping(const std::vector<std::wstring>& header);
+
+    // Rows looked at to give a type to extra columns whose header has none
+    static constexpr size_t kTypeSampleRows = 1000;
+
+    // Type the extra columns the header left untyped from the values in the first rows: Number if
+    // every value is a plain number, Money if every value is an amount and some have a '$', Text
+    // otherwise (or when the sample holds no values). Later calls change nothing.
+    void InferTypes(const std::vector<DataRow>& sample);
+
+    const TableSchema& GetSchema() const;
+    size_t GetFileColumnCount() const;
+    int GetSchemaColumn(size_t fileColumn) const;   // -1 past the header and for computed columns
+
+    // Fill a row from one parsed line. Returns false (row skipped) if the line has a
+    // different number of fields than the header.
+    bool Decode(std::vector<std::wstring>& fields, DataRow& out) const;
+
+private:
+    TableSchema schema;
+    std::vector<int> schemaColumns;     // schema column of each file column (-1 = skipped)
+    std::vector<size_t> untypedColumns; // extra columns waiting for InferTypes
+    bool builtInOrder = true;           // fast path: CostTrackerSchema::Decode
+};
@@ -0,0 +1,171 @@
+//Header for the text encoding helpers. The purpose of these helpers is to convert between the wide strings
+//the spreadsheet keeps in memory and the UTF-8 bytes written to and read from disk.
+
+#pragma once
+
+#include <string>
+#include <fstream>
+
+// Append a wide string to a UTF-8 byte buffer (handles UTF-16 surrogate pairs)
+inline void AppendUtf8(std::string& out, const wchar_t* text, size_t length)
+{
+    for (size_t i = 0; i < length; i++) {
+        unsigned long cp = static_cast<unsigned long>(text[i]);
+
+        if (cp >= 0xD800 && cp <= 0xDBFF && i + 1 < length) {
+            unsigned long low = static_cast<unsigned long>(text[i + 1]);
+            if (low >= 0xDC00 && low <= 0xDFFF) {
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                i++;
+            }
+        }
+
+        if (cp < 0x80) {
+            out += static_cast<char>(cp);
+        } else if (cp < 0x800) {
+            out += static_cast<char>(0xC0 | (cp >> 6));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            out += static_cast<char>(0xE0 | (cp >> 12));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (cp >> 18));
+            out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+    }
+}
+
+inline void AppendUtf8(std::string& out, const std::wstring& text)
+{
+    AppendUtf8(out, text.data(), text.size());
+}
+
+inline std::string WideToUtf8(const std::wstring& text)
+{
+    std::string out;
+    out.reserve(text.size());
+    AppendUtf8(out, text);
+    return out;
+}
+
+// Append a single code point to a wide string (surrogate pair where wchar_t is 16 bits)
+inline void AppendCodePoint(std::wstring& out, unsigned long cp)
+{
+    if (cp >= 0x10000 && sizeof(wchar_t) == 2) {
+        cp -= 0x10000;
+        out += static_cast<wchar_t>(0xD800 + (cp >> 10));
+        out += static_cast<wchar_t>(0xDC00 + (cp & 0x3FF));
+    } else {
+        out += static_cast<wchar_t>(cp);
+    }
+}
+
+// Append UTF-8 bytes to a wide string. Invalid sequences become U+FFFD.
+inline void AppendWide(std::wstring& out, const char* text, size_t length)
+{
+    const unsigned char* s = reinterpret_cast<const unsigned char*>(text);
+    size_t i = 0;
+
+    while (i < length) {
+        unsigned long cp = s[i];
+        size_t extra = 0;
+
+        if (cp < 0x80)                { extra = 0; }
+        else if ((cp & 0xE0) == 0xC0) { extra = 1; cp &= 0x1F; }
+        else if ((cp & 0xF0) == 0xE0) { extra = 2; cp &= 0x0F; }
+        else if ((cp & 0xF8) == 0xF0) { extra = 3; cp &= 0x07; }
+        else {
+            out += L'\xFFFD';
+            i++;
+            continue;
+        }
+
+        if (i + extra >= length) {
+            out += L'\xFFFD';
+            break;
+        }
+
+        bool valid = true;
+        for (size_t k = 1; k <= extra; k++) {
+            if ((s[i + k] & 0xC0) != 0x80) {
+                valid = false;
+                break;
+            }
+            cp = (cp << 6) | (s[i + k] & 0x3F);
+        }
+
+        if (!valid) {
+            out += L'\xFFFD';
+            i++;
+            continue;
+        }
+
+        AppendCodePoint(out, cp);
+        i += extra + 1;
+    }
+}
+
+inline std::wstring Utf8ToWide(const char* text, size_t length)
+{
+    std::wstring out;
+    out.reserve(length);
+    AppendWide(out, text, length);
+    return out;
+}
+
+inline std::wstring Utf8ToWide(const std::string& text)
+{
+    return Utf8ToWide(text.data(), text.size());
+}
+
+// True if the bytes are well-formed UTF-8
+inline bool IsValidUtf8(const char* text, size_t length)
+{
+    const unsigned char* s = reinterpret_cast<const unsigned char*>(text);
+    size_t i = 0;
+
+    while (i < length) {
+        unsigned char c = s[i];
+        size_t extra;
+        if (c < 0x80)                { i++; continue; }
+        else if ((c & 0xE0) == 0xC0) { extra = 1; }
+        else if ((c & 0xF0) == 0xE0) { extra = 2; }
+        else if ((c & 0xF8) == 0xF0) { extra = 3; }
+        else return false;
+
+        if (i + extra >= length)
+            return false;
+        for (size_t k = 1; k <= extra; k++) {
+            if ((s[i + k] & 0xC0) != 0x80)
+                return false;
+        }
+        i += extra + 1;
+    }
+    return true;
+}
+
+// Decode a line of a text file: UTF-8 when it is valid, otherwise one byte per character
+// (Latin-1), which is how files saved by older versions of the program were written.
+inline void AppendTextLine(std::wstring& out, const char* text, size_t length)
+{
+    if (IsValidUtf8(text, length)) {
+        AppendWide(out, text, length);
+        return;
+    }
+    for (size_t i = 0; i < length; i++)
+        out += static_cast<wchar_t>(static_cast<unsigned char>(text[i]));
+}
+
+// Open a file stream from a wide path (MSVC takes wide paths directly, other platforms take UTF-8)
+template <typename Stream>
+inline void OpenFileStream(Stream& stream, const std::wstring& path, std::ios_base::openmode mode)
+{
+#ifdef _WIN32
+    stream.open(path.c_str(), mode);
+#else
+    stream.open(WideToUtf8(path).c_str(), mode);
+#endif
+}
@@ -0,0 +1,349 @@
+//Implementation file for VersionedRowStore class
+
+#include "VersionedRowStore.h"
+#include <functional>
+#include <thread>
+
+//--------------------------------------------------
+// Constructor
+//--------------------------------------------------
+VersionedRowStore::VersionedRowStore() {
+    Version* first = new Version();
+    first->schema = std::make_shared<const TableSchema>();
+    current.store(first);
+}
+
+//--------------------------------------------------
+// Destructor
+// No snapshot may outlive the store.
+//--------------------------------------------------
+VersionedRowStore::~VersionedRowStore() {
+    delete current.load();
+    for (const auto& r : retired)
+        delete r.version;
+}
+
+//--------------------------------------------------
+// Pin
+// Claim a reader slot stamped with the current epoch, then
+// read the current version. A version retired at epoch E is
+// only freed once every pinned slot shows an epoch above E,
+// and any reader stamped above E was pinned after the newer
+// version was published, so it can never see the old one.
+// When every fixed slot is busy an overflow slot is
+// stamped under overflowMutex, which Reclaim also takes.
+//--------------------------------------------------
+size_t VersionedRowStore::Pin(const Version*& outVersion) const {
+    size_t start = std::hash<std::thread::id>()(std::this_thread::get_id()) % kMaxReaders;
+
+    for (size_t i = 0; i < kMaxReaders; ++i) {
+        size_t slot = (start + i) % kMaxReaders;
+        uint64_t expected = kIdle;
+        uint64_t epoch = globalEpoch.load();
+        if (readers[slot].epoch.compare_exchange_strong(expected, epoch)) {
+            outVersion = current.load();
+            return slot;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(overflowMutex);
+    size_t index = 0;
+    while (index < overflow.size() && overflow[index].epoch.load() != kIdle)
+        ++index;
+    if (index == overflow.size())
+        overflow.emplace_back();
+
+    overflow[index].epoch.store(globalEpoch.load());
+    outVersion = current.load();
+    return kMaxReaders + index;
+}
+
+//--------------------------------------------------
+// Unpin
+//--------------------------------------------------
+void VersionedRowStore::Unpin(size_t slot) const {
+    if (slot < kMaxReaders) {
+        readers[slot].epoch.store(kIdle);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(overflowMutex);
+    overflow[slot - kMaxReaders].epoch.store(kIdle);
+}
+
+//--------------------------------------------------
+// Publish a new version and retire the old one
+// (writer mutex held)
+//--------------------------------------------------
+void VersionedRowStore::Publish(Version* next) {
+    const Version* old = current.exchange(next);
+    uint64_t epoch = globalEpoch.fetch_add(1);
+    retired.push_back({ old, epoch });
+    Reclaim();
+}
+
+//--------------------------------------------------
+// Free retired versions no reader can still hold
+// (writer mutex held)
+//--------------------------------------------------
+void VersionedRowStore::Reclaim() {
+    uint64_t oldestReader = kIdle;
+    for (size_t i = 0; i < kMaxReaders; ++i) {
+        uint64_t epoch = readers[i].epoch.load();
+        if (epoch < oldestReader)
+            oldestReader = epoch;
+    }
+    {
+        std::lock_guard<std::mutex> lock(overflowMutex);
+        for (const auto& slot : overflow) {
+            uint64_t epoch = slot.epoch.load();
+            if (epoch < oldestReader)
+                oldestReader = epoch;
+        }
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i < retired.size(); ++i) {
+        if (retired[i].epoch < oldestReader)
+            delete retired[i].version;
+        else
+            retired[kept++] = retired[i];
+    }
+    retired.resize(kept);
+}
+
+//--------------------------------------------------
+// Append To (writer mutex held, next not yet published)
+// The new row goes into a free slot of the last chunk, which
+// no published version can see yet, so the chunk is shared
+// rather than copied.
+//--------------------------------------------------
+void VersionedRowStore::AppendTo(Version& next, const DataRow& row) {
+    size_t offset = next.rowCount % kChunkRows;
+    if (offset == 0) {
+        next.chunks.push_back(std::make_shared<Chunk>());
+    } else if (next.chunks.back()->used != offset) {
+        // Slot already filled by a newer version that was since erased; copy instead
+        auto copy = std::make_shared<Chunk>();
+        for (size_t i = 0; i < offset; ++i)
+            copy->rows[i] = next.chunks.back()->rows[i];
+        copy->used = offset;
+        next.chunks.back() = copy;
+    }
+
+    Chunk& tail = *next.chunks.back();
+    tail.rows[offset] = row;
+    tail.used = offset + 1;
+    next.rowCount++;
+}
+
+//--------------------------------------------------
+// Append (one row)
+//--------------------------------------------------
+void VersionedRowStore::Append(const DataRow& row) {
+    std::lock_guard<std::mutex> lock(writerMutex);
+
+    Version* next = new Version(*current.load());
+    next->number++;
+    AppendTo(*next, row);
+    Publish(next);
+}
+
+//--------------------------------------------------
+// Append (many rows, one version)
+//--------------------------------------------------
+void VersionedRowStore::Append(const std::vector<DataRow>& rows) {
+    if (rows.empty())
+        return;
+
+    std::lock_guard<std::mutex> lock(writerMutex);
+
+    Version* next = new Version(*current.load());
+    next->number++;
+    for (const auto& row : rows)
+        AppendTo(*next, row);
+    Publish(next);
+}
+
+//--------------------------------------------------
+// Update (copies the one chunk holding the row)
+//--------------------------------------------------
+bool VersionedRowStore::Update(size_t index, const DataRow& row) {
+    std::lock_guard<std::mutex> lock(writerMutex);
+
+    const Version* cur = current.load();
+    if (index >= cur->rowCount)
+        return false;
+
+    Version* next = new Version(*cur);
+    next->number++;
+
+    const Chunk& source = *cur->chunks[index / kChunkRows];
+    auto copy = std::make_shared<Chunk>();
+    for (size_t i = 0; i < source.used; ++i)
+        copy->rows[i] = source.rows[i];
+    copy->used = source.used;
+    copy->rows[index % kChunkRows] = row;
+    next->chunks[index / kChunkRows] = copy;
+
+    Publish(next);
+    return true;
+}
+
+//--------------------------------------------------
+// Erase
+// Chunks before the erased row are shared; the rest are
+// rebuilt because every later row moves down one place.
+//--------------------------------------------------
+bool VersionedRowStore::Erase(size_t index) {
+    std::lock_guard<std::mutex> lock(writerMutex);
+
+    const Version* cur = current.load();
+    if (index >= cur->rowCount)
+        return false;
+
+    size_t firstChunk = index / kChunkRows;
+
+    Version* next = new Version();
+    next->number = cur->number + 1;
+    next->schema = cur->schema;
+    next->chunks.assign(cur->chunks.begin(), cur->chunks.begin() + firstChunk);
+    next->rowCount = firstChunk * kChunkRows;
+
+    for (size_t i = next->rowCount; i < cur->rowCount; ++i) {
+        if (i == index)
+            continue;
+
+        size_t offset = next->rowCount % kChunkRows;
+        if (offset == 0)
+            next->chunks.push_back(std::make_shared<Chunk>());
+
+        Chunk& tail = *next->chunks.back();
+        tail.rows[offset] = cur->chunks[i / kChunkRows]->rows[i % kChunkRows];
+        tail.used = offset + 1;
+        next->rowCount++;
+    }
+
+    Publish(next);
+    return true;
+}
+
+//--------------------------------------------------
+// Clear
+//--------------------------------------------------
+void VersionedRowStore::Clear() {
+    std::lock_guard<std::mutex> lock(writerMutex);
+
+    const Version* cur = current.load();
+    Version* next = new Version();
+    next->number = cur->number + 1;
+    next->schema = cur->schema;
+    Publish(next);
+}
+
+//--------------------------------------------------
+// Set Schema (same rows, new columns)
+//--------------------------------------------------
+void VersionedRowStore::SetSchema(const TableSchema& schema) {
+    std::lock_guard<std::mutex> lock(writerMutex);
+
+    Version* next = new Version(*current.load());
+    next->number++;
+    next->schema = std::make_shared<const TableSchema>(schema);
+    Publish(next);
+}
+
+//--------------------------------------------------
+// Replace
+// New rows and columns in one version, so no reader sees
+// the old rows under the new columns or an empty table.
+//--------------------------------------------------
+void VersionedRowStore::Replace(const std::vector<DataRow>& rows, const TableSchema& schema) {
+    std::lock_guard<std::mutex> lock(writerMutex);
+
+    Version* next = new Version();
+    next->number = current.load()->number + 1;
+    next->schema = std::make_shared<const TableSchema>(schema);
+    for (const auto& row : rows)
+        AppendTo(*next, row);
+    Publish(next);
+}
+
+//--------------------------------------------------
+// Get Snapshot
+//--------------------------------------------------
+VersionedRowStore::Snapshot VersionedRowStore::GetSnapshot() const {
+    Snapshot snapshot;
+    snapshot.store = this;
+    snapshot.slot = Pin(snapshot.version);
+    return snapshot;
+}
+
+//--------------------------------------------------
+// Get Row Count
+//--------------------------------------------------
+size_t VersionedRowStore::GetRowCount() const {
+    return GetSnapshot().GetRowCount();
+}
+
+//--------------------------------------------------
+// Snapshot: move / release
+//--------------------------------------------------
+VersionedRowStore::Snapshot::Snapshot(Snapshot&& other) noexcept
+    : store(other.store), version(other.version), slot(other.slot)
+{
+    other.store = nullptr;
+    other.version = nullptr;
+}
+
+VersionedRowStore::Snapshot& VersionedRowStore::Snapshot::operator=(Snapshot&& other) noexcept {
+    if (this != &other) {
+        Release();
+        store = other.store;
+        version = other.version;
+        slot = other.slot;
+        other.store = nullptr;
+        other.version = nullptr;
+    }
+    return *this;
+}
+
+VersionedRowStore::Snapshot::~Snapshot() {
+    Release();
+}
+
+void VersionedRowStore::Snapshot::Release() {
+    if (store) {
+        store->Unpin(slot);
+        store = nullptr;
+        version = nullptr;
+    }
+}
+
+//--------------------------------------------------
+// Snapshot: access
+//--------------------------------------------------
+size_t VersionedRowStore::Snapshot::GetRowCount() const {
+    return version ? version->rowCount : 0;
+}
+
+const DataRow& VersionedRowStore::Snapshot::GetRow(size_t index) const {
+    return version->chunks[index / kChunkRows]->rows[index % kChunkRows];
+}
+
+std::vector<DataRow> VersionedRowStore::Snapshot::CopyRows() const {
+    std::vector<DataRow> result;
+    size_t count = GetRowCount();
+    result.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+        result.push_back(GetRow(i));
+    return result;
+}
+
+const TableSchema& VersionedRowStore::Snapshot::GetSchema() const {
+    return version ? *version->schema : TableSchema::CostTracker();
+}
+
+uint64_t VersionedRowStore::Snapshot::GetVersion() const {
+    return version ? version->number : 0;
+}
@@ -0,0 +1,121 @@
+//Header for the VersionedRowStore class. The purpose of the class is to let background work (totals, saving,
+//exports) read the table while the user keeps editing it. Every edit publishes a new immutable version of the
+//rows; readers take a Snapshot of the current version without locking and keep seeing exactly that version until
+//they let it go. Versions share unchanged chunks of rows, and old versions are freed with epoch-based reclamation
+//once no reader can still be looking at them.
+//
+//Each version also carries the sheet's schema, so a reader sees rows and columns that belong together.
+//
+//Only one thread at a time may edit (edits are serialised by an internal mutex); any number of threads may read.
+//The first kMaxReaders snapshots held at once pin without locking; beyond that, readers take an overflow slot
+//under a mutex instead of waiting for one to come free.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "DataRow.h"
+#include "TableSchema.h"
+
+class VersionedRowStore {
+    struct Version;
+
+public:
+    // A stable, read-only view of the rows as they were when the snapshot was taken.
+    // Holding a snapshot delays freeing of that version, so keep it only as long as needed.
+    class Snapshot {
+    public:
+        Snapshot() = default;
+        Snapshot(Snapshot&& other) noexcept;
+        Snapshot& operator=(Snapshot&& other) noexcept;
+        Snapshot(const Snapshot&) = delete;
+        Snapshot& operator=(const Snapshot&) = delete;
+        ~Snapshot();
+
+        size_t GetRowCount() const;
+        const DataRow& GetRow(size_t index) const;
+        std::vector<DataRow> CopyRows() const;
+
+        // Columns of the rows in this snapshot
+        const TableSchema& GetSchema() const;
+
+        // Version number; increases by one with every published edit
+        uint64_t GetVersion() const;
+
+    private:
+        friend class VersionedRowStore;
+        void Release();
+
+        const VersionedRowStore* store = nullptr;
+        const Version* version = nullptr;
+        size_t slot = 0;
+    };
+
+    VersionedRowStore();
+    ~VersionedRowStore();
+    VersionedRowStore(const VersionedRowStore&) = delete;
+    VersionedRowStore& operator=(const VersionedRowStore&) = delete;
+
+    // Edits. Each call publishes one new version.
+    void Append(const DataRow& row);
+    void Append(const std::vector<DataRow>& rows);
+    bool Update(size_t index, const DataRow& row);
+    bool Erase(size_t index);
+    void Clear();
+    void SetSchema(const TableSchema& schema);
+    void Replace(const std::vector<DataRow>& rows, const TableSchema& schema);     // e.g. after a reload
+
+    Snapshot GetSnapshot() const;
+    size_t GetRowCount() const;
+
+private:
+    static const size_t kChunkRows = 1024;
+    static const size_t kMaxReaders = 64;
+    static const uint64_t kIdle = UINT64_MAX;
+
+    // Rows are stored in fixed-size chunks. A chunk is never changed once a published version can see
+    // the changed slot: updates and erases copy the chunk, and appends only fill slots past the end of
+    // every version that shares it.
+    struct Chunk {
+        std::unique_ptr<DataRow[]> rows{ new DataRow[kChunkRows] };
+        size_t used = 0;        // filled slots; only touched by the writer
+    };
+
+    struct Version {
+        std::vector<std::shared_ptr<Chunk>> chunks;
+        size_t rowCount = 0;
+        uint64_t number = 0;
+        std::shared_ptr<const TableSchema> schema;     // shared by every version until it changes
+    };
+
+    struct Retired {
+        const Version* version;
+        uint64_t epoch;         // freed once every active reader has a later epoch
+    };
+
+    // One cache line per reader so pinning does not bounce lines between cores
+    struct alignas(64) ReaderSlot {
+        std::atomic<uint64_t> epoch{ kIdle };
+    };
+
+    static void AppendTo(Version& next, const DataRow& row);
+    void Publish(Version* next);
+    void Reclaim();
+    size_t Pin(const Version*& outVersion) const;
+    void Unpin(size_t slot) const;
+
+    std::atomic<const Version*> current{ nullptr };
+    mutable std::atomic<uint64_t> globalEpoch{ 1 };
+    mutable ReaderSlot readers[kMaxReaders];
+
+    // Slots kMaxReaders and up; only used while every fixed slot is busy. Never shrinks.
+    mutable std::mutex overflowMutex;
+    mutable std::deque<ReaderSlot> overflow;
+
+    std::mutex writerMutex;
+    std::vector<Retired> retired;
+};
@@ -0,0 +1,775 @@
+//Implementation file for the ZipWriter and ZipReader classes
+
+#include "ZipArchive.h"
+#include "TextEncoding.h"
+#include <algorithm>
+#include <ctime>
+
+namespace {
+
+const uint32_t kLocalHeaderSig   = 0x04034b50;
+const uint32_t kCentralHeaderSig = 0x02014b50;
+const uint32_t kEndOfDirSig      = 0x06054b50;
+const uint32_t kZip64EndSig      = 0x06064b50;
+const uint32_t kZip64LocatorSig  = 0x07064b50;
+const uint16_t kUtf8NameFlag     = 0x0800;
+
+void PutU16(std::string& out, uint16_t v)
+{
+    out += static_cast<char>(v & 0xFF);
+    out += static_cast<char>((v >> 8) & 0xFF);
+}
+
+void PutU32(std::string& out, uint32_t v)
+{
+    PutU16(out, static_cast<uint16_t>(v & 0xFFFF));
+    PutU16(out, static_cast<uint16_t>(v >> 16));
+}
+
+uint16_t GetU16(const unsigned char* p)
+{
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+uint32_t GetU32(const unsigned char* p)
+{
+    return static_cast<uint32_t>(GetU16(p)) | (static_cast<uint32_t>(GetU16(p + 2)) << 16);
+}
+
+uint64_t GetU64(const unsigned char* p)
+{
+    return static_cast<uint64_t>(GetU32(p)) | (static_cast<uint64_t>(GetU32(p + 4)) << 32);
+}
+
+//--------------------------------------------------
+// Inflate (RFC 1951) with a 32 KB sliding window.
+// Output is handed to the sink each time the window
+// fills, so memory use does not depend on entry size.
+//--------------------------------------------------
+const size_t kWindowSize = 32768;
+const size_t kInputBufferSize = 65536;
+
+struct Huffman {
+    short count[16];
+    short symbol[288];
+};
+
+const short kLengthBase[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+const short kLengthExtra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+const short kDistBase[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+    8193, 12289, 16385, 24577 };
+const short kDistExtra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+// Build canonical Huffman decoding tables.
+// Returns 0 for a complete code, >0 for incomplete, <0 for over-subscribed.
+int BuildHuffman(Huffman& h, const short* lengths, int n)
+{
+    for (int len = 0; len < 16; len++)
+        h.count[len] = 0;
+    for (int sym = 0; sym < n; sym++)
+        h.count[lengths[sym]]++;
+
+    if (h.count[0] == n)
+        return 0;
+
+    int left = 1;
+    for (int len = 1; len < 16; len++) {
+        left <<= 1;
+        left -= h.count[len];
+        if (left < 0)
+            return left;
+    }
+
+    short offs[16];
+    offs[1] = 0;
+    for (int len = 1; len < 15; len++)
+        offs[len + 1] = offs[len] + h.count[len];
+
+    for (int sym = 0; sym < n; sym++) {
+        if (lengths[sym] != 0)
+            h.symbol[offs[lengths[sym]]++] = static_cast<short>(sym);
+    }
+
+    return left;
+}
+
+class Inflater {
+public:
+    Inflater(std::istream& in, uint64_t compressedSize, const ZipSink& sink)
+        : in(in), remaining(compressedSize), sink(sink),
+          input(kInputBufferSize), window(kWindowSize) {}
+
+    bool Run(uint32_t& outCrc);
+
+private:
+    bool NeedBits(int need);
+    bool Bits(int need, int& out);
+    bool Decode(const Huffman& h, int& sym);
+
+    bool Stored();
+    bool Fixed();
+    bool Dynamic();
+    bool Codes(const Huffman& lencode, const Huffman& distcode);
+
+    bool Put(unsigned char c);
+    bool Flush();
+
+    std::istream& in;
+    uint64_t remaining;
+    const ZipSink& sink;
+
+    std::vector<char> input;
+    size_t inPos = 0;
+    size_t inLen = 0;
+    uint32_t bitBuf = 0;
+    int bitCount = 0;
+
+    std::vector<unsigned char> window;
+    size_t windowPos = 0;
+    size_t flushedPos = 0;
+    uint64_t total = 0;
+    uint32_t crc = 0;
+    bool stopped = false;
+};
+
+bool Inflater::NeedBits(int need)
+{
+    while (bitCount < need) {
+        if (inPos == inLen) {
+            if (remaining == 0)
+                return false;
+            size_t chunk = static_cast<size_t>(std::min<uint64_t>(remaining, input.size()));
+            in.read(input.data(), static_cast<std::streamsize>(chunk));
+            inLen = static_cast<size_t>(in.gcount());
+            inPos = 0;
+            if (inLen == 0)
+                return false;
+            remaining -= inLen;
+        }
+        bitBuf |= static_cast<uint32_t>(static_cast<unsigned char>(input[inPos++])) << bitCount;
+        bitCount += 8;
+    }
+    return true;
+}
+
+bool Inflater::Bits(int need, int& out)
+{
+    if (need == 0) {
+        out = 0;
+        return true;
+    }
+    if (!NeedBits(need))
+        return false;
+
+    out = static_cast<int>(bitBuf & ((1u << need) - 1));
+    bitBuf >>= need;
+    bitCount -= need;
+    return true;
+}
+
+bool Inflater::Decode(const Huffman& h, int& sym)
+{
+    int code = 0, first = 0, index = 0;
+
+    for (int len = 1; len < 16; len++) {
+        int bit;
+        if (!Bits(1, bit))
+            return false;
+        code |= bit;
+
+        int count = h.count[len];
+        if (code - count < first) {
+            sym = h.symbol[index + (code - first)];
+            return true;
+        }
+        index += count;
+        first += count;
+        first <<= 1;
+        code <<= 1;
+    }
+    return false;
+}
+
+bool Inflater::Flush()
+{
+    if (windowPos > flushedPos) {
+        const char* data = reinterpret_cast<const char*>(window.data() + flushedPos);
+        size_t size = windowPos - flushedPos;
+        crc = ZipCrc32(crc, data, size);
+        if (!sink(data, size))
+            stopped = true;
+    }
+
+    if (windowPos == kWindowSize)
+        windowPos = 0;
+    flushedPos = windowPos;
+    return !stopped;
+}
+
+bool Inflater::Put(unsigned char c)
+{
+    window[windowPos++] = c;
+    total++;
+    if (windowPos == kWindowSize)
+        return Flush();
+    return true;
+}
+
+bool Inflater::Stored()
+{
+    // Discard the rest of the current byte
+    bitBuf = 0;
+    bitCount = 0;
+
+    int len, nlen;
+    if (!Bits(16, len) || !Bits(16, nlen))
+        return false;
+    if (len != (~nlen & 0xFFFF))
+        return false;
+
+    while (len-- > 0) {
+        int c;
+        if (!Bits(8, c) || !Put(static_cast<unsigned char>(c)))
+            return false;
+    }
+    return true;
+}
+
+bool Inflater::Codes(const Huffman& lencode, const Huffman& distcode)
+{
+    for (;;) {
+        int sym;
+        if (!Decode(lencode, sym))
+            return false;
+
+        if (sym < 256) {
+            if (!Put(static_cast<unsigned char>(sym)))
+                return false;
+        }
+        else if (sym == 256) {
+            return true;
+        }
+        else {
+            sym -= 257;
+            if (sym >= 29)
+                return false;
+
+            int extra;
+            if (!Bits(kLengthExtra[sym], extra))
+                return false;
+            int len = kLengthBase[sym] + extra;
+
+            int dsym;
+            if (!Decode(distcode, dsym) || dsym >= 30)
+                return false;
+            if (!Bits(kDistExtra[dsym], extra))
+                return false;
+            size_t dist = static_cast<size_t>(kDistBase[dsym] + extra);
+            if (dist > total)
+                return false;
+
+            while (len-- > 0) {
+                unsigned char c = window[(windowPos + kWindowSize - dist) % kWindowSize];
+                if (!Put(c))
+                    return false;
+            }
+        }
+    }
+}
+
+struct FixedTables {
+    Huffman lencode;
+    Huffman distcode;
+
+    FixedTables() {
+        short lengths[288];
+        int sym = 0;
+        for (; sym < 144; sym++) lengths[sym] = 8;
+        for (; sym < 256; sym++) lengths[sym] = 9;
+        for (; sym < 280; sym++) lengths[sym] = 7;
+        for (; sym < 288; sym++) lengths[sym] = 8;
+        BuildHuffman(lencode, lengths, 288);
+
+        for (sym = 0; sym < 30; sym++) lengths[sym] = 5;
+        BuildHuffman(distcode, lengths, 30);
+    }
+};
+
+bool Inflater::Fixed()
+{
+    static const FixedTables tables;
+    return Codes(tables.lencode, tables.distcode);
+}
+
+bool Inflater::Dynamic()
+{
+    static const short order[19] = {
+        16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+    int nlen, ndist, ncode;
+    if (!Bits(5, nlen) || !Bits(5, ndist) || !Bits(4, ncode))
+        return false;
+    nlen += 257;
+    ndist += 1;
+    ncode += 4;
+    if (nlen > 286 || ndist > 30)
+        return false;
+
+    short lengths[320] = {};
+    for (int i = 0; i < ncode; i++) {
+        int v;
+        if (!Bits(3, v))
+            return false;
+        lengths[order[i]] = static_cast<short>(v);
+    }
+
+    Huffman lencode, distcode;
+    if (BuildHuffman(lencode, lengths, 19) != 0)
+        return false;
+
+    int index = 0;
+    while (index < nlen + ndist) {
+        int sym;
+        if (!Decode(lencode, sym))
+            return false;
+
+        if (sym < 16) {
+            lengths[index++] = static_cast<short>(sym);
+            continue;
+        }
+
+        short len = 0;
+        int repeat;
+        if (sym == 16) {
+            if (index == 0)
+                return false;
+            len = lengths[index - 1];
+            if (!Bits(2, repeat))
+                return false;
+            repeat += 3;
+        }
+        else if (sym == 17) {
+            if (!Bits(3, repeat))
+                return false;
+            repeat += 3;
+        }
+        else {
+            if (!Bits(7, repeat))
+                return false;
+            repeat += 11;
+        }
+
+        if (index + repeat > nlen + ndist)
+            return false;
+        while (repeat-- > 0)
+            lengths[index++] = len;
+    }
+
+    if (lengths[256] == 0)
+        return false;
+
+    int err = BuildHuffman(lencode, lengths, nlen);
+    if (err < 0 || (err > 0 && nlen - lencode.count[0] != 1))
+        return false;
+
+    err = BuildHuffman(distcode, lengths + nlen, ndist);
+    if (err < 0 || (err > 0 && ndist - distcode.count[0] != 1))
+        return false;
+
+    return Codes(lencode, distcode);
+}
+
+bool Inflater::Run(uint32_t& outCrc)
+{
+    int last;
+    do {
+        int type;
+        if (!Bits(1, last) || !Bits(2, type))
+            return false;
+
+        bool ok = false;
+        if (type == 0)      ok = Stored();
+        else if (type == 1) ok = Fixed();
+        else if (type == 2) ok = Dynamic();
+
+        if (!ok)
+            return false;
+    } while (!last);
+
+    if (!Flush())
+        return false;
+
+    outCrc = crc;
+    return true;
+}
+
+} // namespace
+
+//--------------------------------------------------
+// CRC-32
+//--------------------------------------------------
+uint32_t ZipCrc32(uint32_t crc, const char* data, size_t size)
+{
+    struct Table {
+        uint32_t entries[256];
+
+        Table() {
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; k++)
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                entries[i] = c;
+            }
+        }
+    };
+    static const Table table;
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++)
+        crc = table.entries[(crc ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+//--------------------------------------------------
+// ZipWriter
+//--------------------------------------------------
+ZipWriter::~ZipWriter() {
+    if (file.is_open())
+        file.close();
+}
+
+bool ZipWriter::Open(const std::wstring& filePath) {
+    OpenFileStream(file, filePath, std::ios::binary | std::ios::trunc | std::ios::out);
+    if (!file.is_open())
+        return false;
+
+    std::time_t now = std::time(nullptr);
+    std::tm local{};
+#ifdef _WIN32
+    localtime_s(&local, &now);
+#else
+    localtime_r(&now, &local);
+#endif
+    dosTime = static_cast<uint16_t>((local.tm_hour << 11) | (local.tm_min << 5) | (local.tm_sec / 2));
+    dosDate = static_cast<uint16_t>(((local.tm_year - 80) << 9) | ((local.tm_mon + 1) << 5) | local.tm_mday);
+
+    entries.clear();
+    inEntry = false;
+    failed = false;
+    return true;
+}
+
+void ZipWriter::WriteLocalHeader(const Entry& entry) {
+    std::string header;
+    PutU32(header, kLocalHeaderSig);
+    PutU16(header, 20);             // version needed
+    PutU16(header, kUtf8NameFlag);
+    PutU16(header, 0);              // stored
+    PutU16(header, dosTime);
+    PutU16(header, dosDate);
+    PutU32(header, entry.crc);
+    PutU32(header, entry.size);     // compressed size
+    PutU32(header, entry.size);
+    PutU16(header, static_cast<uint16_t>(entry.name.size()));
+    PutU16(header, 0);              // extra length
+    header += entry.name;
+    file.write(header.data(), static_cast<std::streamsize>(header.size()));
+}
+
+bool ZipWriter::BeginEntry(const std::string& name) {
+    if (!file.is_open() || inEntry || failed)
+        return false;
+
+    std::streamoff offset = file.tellp();
+    if (offset < 0 || static_cast<uint64_t>(offset) > 0xFFFFFFFFull)
+        return false;
+
+    Entry entry;
+    entry.name = name;
+    entry.offset = static_cast<uint32_t>(offset);
+
+    // Sizes and CRC are patched in EndEntry once the data is known
+    WriteLocalHeader(entry);
+    entries.push_back(entry);
+
+    inEntry = true;
+    entrySize = 0;
+    entryCrc = 0;
+    return static_cast<bool>(file);
+}
+
+bool ZipWriter::Write(const char* data, size_t size) {
+    if (!inEntry || failed)
+        return false;
+
+    entryCrc = ZipCrc32(entryCrc, data, size);
+    entrySize += size;
+    if (entrySize > 0xFFFFFFFFull) {
+        failed = true;
+        return false;
+    }
+
+    file.write(data, static_cast<std::streamsize>(size));
+    return static_cast<bool>(file);
+}
+
+bool ZipWriter::Write(const std::string& data) {
+    return Write(data.data(), data.size());
+}
+
+bool ZipWriter::EndEntry() {
+    if (!inEntry)
+        return false;
+    inEntry = false;
+    if (failed)
+        return false;
+
+    Entry& entry = entries.back();
+    entry.crc = entryCrc;
+    entry.size = static_cast<uint32_t>(entrySize);
+
+    std::streamoff end = file.tellp();
+    std::string patch;
+    PutU32(patch, entry.crc);
+    PutU32(patch, entry.size);
+    PutU32(patch, entry.size);
+
+    file.seekp(entry.offset + 14);
+    file.write(patch.data(), static_cast<std::streamsize>(patch.size()));
+    file.seekp(end);
+    return static_cast<bool>(file);
+}
+
+bool ZipWriter::AddEntry(const std::string& name, const std::string& data) {
+    return BeginEntry(name) && Write(data) && EndEntry();
+}
+
+bool ZipWriter::Close() {
+    if (!file.is_open())
+        return false;
+    if (inEntry || failed) {
+        file.close();
+        return false;
+    }
+
+    std::streamoff dirOffset = file.tellp();
+    std::string dir;
+
+    for (const auto& entry : entries) {
+        PutU32(dir, kCentralHeaderSig);
+        PutU16(dir, 20);            // version made by
+        PutU16(dir, 20);            // version needed
+        PutU16(dir, kUtf8NameFlag);
+        PutU16(dir, 0);             // stored
+        PutU16(dir, dosTime);
+        PutU16(dir, dosDate);
+        PutU32(dir, entry.crc);
+        PutU32(dir, entry.size);
+        PutU32(dir, entry.size);
+        PutU16(dir, static_cast<uint16_t>(entry.name.size()));
+        PutU16(dir, 0);             // extra length
+        PutU16(dir, 0);             // comment length
+        PutU16(dir, 0);             // disk number
+        PutU16(dir, 0);             // internal attributes
+        PutU32(dir, 0);             // external attributes
+        PutU32(dir, entry.offset);
+        dir += entry.name;
+    }
+
+    uint32_t dirSize = static_cast<uint32_t>(dir.size());
+    PutU32(dir, kEndOfDirSig);
+    PutU16(dir, 0);
+    PutU16(dir, 0);
+    PutU16(dir, static_cast<uint16_t>(entries.size()));
+    PutU16(dir, static_cast<uint16_t>(entries.size()));
+    PutU32(dir, dirSize);
+    PutU32(dir, static_cast<uint32_t>(dirOffset));
+    PutU16(dir, 0);
+
+    file.write(dir.data(), static_cast<std::streamsize>(dir.size()));
+    bool ok = static_cast<bool>(file) && dirOffset <= 0xFFFFFFFF;
+    file.close();
+    return ok;
+}
+
+//--------------------------------------------------
+// ZipReader
+//--------------------------------------------------
+bool ZipReader::Open(const std::wstring& filePath) {
+    entries.clear();
+    OpenFileStream(file, filePath, std::ios::binary | std::ios::in);
+    if (!file.is_open())
+        return false;
+
+    file.seekg(0, std::ios::end);
+    uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+    if (fileSize < 22)
+        return false;
+
+    // End of central directory record is in the last 64 KB + 22 bytes
+    uint64_t tailSize = std::min<uint64_t>(fileSize, 65557);
+    std::vector<unsigned char> tail(static_cast<size_t>(tailSize));
+    file.seekg(static_cast<std::streamoff>(fileSize - tailSize));
+    file.read(reinterpret_cast<char*>(tail.data()), static_cast<std::streamsize>(tailSize));
+    if (!file)
+        return false;
+
+    size_t eocd = std::string::npos;
+    for (size_t i = tail.size() - 22 + 1; i-- > 0;) {
+        if (GetU32(&tail[i]) == kEndOfDirSig) {
+            eocd = i;
+            break;
+        }
+    }
+    if (eocd == std::string::npos)
+        return false;
+
+    uint64_t entryCount = GetU16(&tail[eocd + 10]);
+    uint64_t dirSize    = GetU32(&tail[eocd + 12]);
+    uint64_t dirOffset  = GetU32(&tail[eocd + 16]);
+
+    // Zip64 archives keep the real values in a separate record
+    if ((entryCount == 0xFFFF || dirOffset == 0xFFFFFFFF) && eocd >= 20 &&
+        GetU32(&tail[eocd - 20]) == kZip64LocatorSig) {
+        uint64_t zip64Offset = GetU64(&tail[eocd - 20 + 8]);
+        unsigned char record[56];
+        file.seekg(static_cast<std::streamoff>(zip64Offset));
+        file.read(reinterpret_cast<char*>(record), sizeof(record));
+        if (!file || GetU32(record) != kZip64EndSig)
+            return false;
+        entryCount = GetU64(record + 32);
+        dirSize    = GetU64(record + 40);
+        dirOffset  = GetU64(record + 48);
+    }
+
+    std::vector<unsigned char> dir(static_cast<size_t>(dirSize));
+    file.seekg(static_cast<std::streamoff>(dirOffset));
+    file.read(reinterpret_cast<char*>(dir.data()), static_cast<std::streamsize>(dirSize));
+    if (!file)
+        return false;
+
+    size_t pos = 0;
+    for (uint64_t i = 0; i < entryCount; i++) {
+        if (pos + 46 > dir.size() || GetU32(&dir[pos]) != kCentralHeaderSig)
+            return false;
+
+        Entry entry;
+        entry.method         = GetU16(&dir[pos + 10]);
+        entry.crc            = GetU32(&dir[pos + 16]);
+        entry.compressedSize = GetU32(&dir[pos + 20]);
+        entry.size           = GetU32(&dir[pos + 24]);
+        uint16_t nameLen     = GetU16(&dir[pos + 28]);
+        uint16_t extraLen    = GetU16(&dir[pos + 30]);
+        uint16_t commentLen  = GetU16(&dir[pos + 32]);
+        entry.localOffset    = GetU32(&dir[pos + 42]);
+
+        if (pos + 46 + nameLen + extraLen + commentLen > dir.size())
+            return false;
+        entry.name.assign(reinterpret_cast<const char*>(&dir[pos + 46]), nameLen);
+
+        // Zip64 extended information replaces any field stored as 0xFFFFFFFF
+        size_t extra = pos + 46 + nameLen;
+        size_t extraEnd = extra + extraLen;
+        while (extra + 4 <= extraEnd) {
+            uint16_t id = GetU16(&dir[extra]);
+            uint16_t len = GetU16(&dir[extra + 2]);
+            size_t field = extra + 4;
+            if (id == 0x0001) {
+                if (entry.size == 0xFFFFFFFF && field + 8 <= extraEnd) {
+                    entry.size = GetU64(&dir[field]);
+                    field += 8;
+                }
+                if (entry.compressedSize == 0xFFFFFFFF && field + 8 <= extraEnd) {
+                    entry.compressedSize = GetU64(&dir[field]);
+                    field += 8;
+                }
+                if (entry.localOffset == 0xFFFFFFFF && field + 8 <= extraEnd)
+                    entry.localOffset = GetU64(&dir[field]);
+            }
+            extra += 4 + len;
+        }
+
+        entries.push_back(entry);
+        pos += 46 + nameLen + extraLen + commentLen;
+    }
+
+    return true;
+}
+
+const ZipReader::Entry* ZipReader::FindEntry(const std::string& name) const {
+    for (const auto& entry : entries) {
+        if (entry.name == name)
+            return &entry;
+    }
+    return nullptr;
+}
+
+bool ZipReader::HasEntry(const std::string& name) const {
+    return FindEntry(name) != nullptr;
+}
+
+std::vector<std::string> ZipReader::GetEntryNames() const {
+    std::vector<std::string> names;
+    for (const auto& entry : entries)
+        names.push_back(entry.name);
+    return names;
+}
+
+bool ZipReader::ReadEntry(const std::string& name, const ZipSink& sink) {
+    const Entry* entry = FindEntry(name);
+    if (!entry || !file.is_open())
+        return false;
+
+    unsigned char header[30];
+    file.clear();
+    file.seekg(static_cast<std::streamoff>(entry->localOffset));
+    file.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (!file || GetU32(header) != kLocalHeaderSig)
+        return false;
+
+    uint64_t dataOffset = entry->localOffset + 30 + GetU16(header + 26) + GetU16(header + 28);
+    file.seekg(static_cast<std::streamoff>(dataOffset));
+
+    uint32_t crc = 0;
+
+    if (entry->method == 0) {
+        std::vector<char> buffer(kInputBufferSize);
+        uint64_t remaining = entry->size;
+        while (remaining > 0) {
+            size_t chunk = static_cast<size_t>(std::min<uint64_t>(remaining, buffer.size()));
+            file.read(buffer.data(), static_cast<std::streamsize>(chunk));
+            if (!file)
+                return false;
+            crc = ZipCrc32(crc, buffer.data(), chunk);
+            if (!sink(buffer.data(), chunk))
+                return false;
+            remaining -= chunk;
+        }
+    }
+    else if (entry->method == 8) {
+        Inflater inflater(file, entry->compressedSize, sink);
+        if (!inflater.Run(crc))
+            return false;
+    }
+    else {
+        return false;   // unsupported compression method
+    }
+
+    return crc == entry->crc;
+}
+
+bool ZipReader::ReadEntry(const std::string& name, std::string& outData) {
+    outData.clear();
+    return ReadEntry(name, [&outData](const char* data, size_t size) {
+        outData.append(data, size);
+        return true;
+    });
+}
@@ -0,0 +1,83 @@
+//Header for the ZipWriter and ZipReader classes. The purpose of these classes is to provide the zip container
+//used by .xlsx workbooks without any external library. Entries are streamed in and out in small pieces so
+//large worksheets never have to be held in memory.
+
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Called with each piece of decompressed entry data. Return false to stop reading.
+using ZipSink = std::function<bool(const char* data, size_t size)>;
+
+class ZipWriter {
+public:
+    ZipWriter() = default;
+    ~ZipWriter();
+
+    bool Open(const std::wstring& filePath);
+    bool Close();
+
+    // Streamed entry: BeginEntry, any number of Write calls, then EndEntry
+    bool BeginEntry(const std::string& name);
+    bool Write(const char* data, size_t size);
+    bool Write(const std::string& data);
+    bool EndEntry();
+
+    // Whole entry in one call
+    bool AddEntry(const std::string& name, const std::string& data);
+
+private:
+    struct Entry {
+        std::string name;
+        uint32_t crc = 0;
+        uint32_t size = 0;
+        uint32_t offset = 0;
+    };
+
+    void WriteLocalHeader(const Entry& entry);
+
+    std::ofstream file;
+    std::vector<Entry> entries;
+    bool inEntry = false;
+    bool failed = false;
+    uint64_t entrySize = 0;
+    uint32_t entryCrc = 0;
+    uint16_t dosTime = 0;
+    uint16_t dosDate = 0;
+};
+
+class ZipReader {
+public:
+    bool Open(const std::wstring& filePath);
+
+    bool HasEntry(const std::string& name) const;
+    std::vector<std::string> GetEntryNames() const;
+
+    // Decompress an entry and pass it to the sink in pieces. The CRC is checked at the end.
+    bool ReadEntry(const std::string& name, const ZipSink& sink);
+
+    // Convenience for small entries
+    bool ReadEntry(const std::string& name, std::string& outData);
+
+private:
+    struct Entry {
+        std::string name;
+        uint16_t method = 0;
+        uint32_t crc = 0;
+        uint64_t compressedSize = 0;
+        uint64_t size = 0;
+        uint64_t localOffset = 0;
+    };
+
+    const Entry* FindEntry(const std::string& name) const;
+
+    std::ifstream file;
+    std::vector<Entry> entries;
+};
+
+// CRC-32 used by zip (running value, start with 0)
+uint32_t ZipCrc32(uint32_t crc, const char* data, size_t size);
@@ -3,9 +3,13 @@
 #include <string>
 #include <sstream>
 #include <iomanip>
+#include <memory>
 #include <commdlg.h>
 #include "DataTable.h"
 #include "SpreadsheetStorage.h"
+#include "ImportValidator.h"
+#include "CsvFollower.h"
+#include "CostAnalytics.h"
 
 #pragma comment(lib, "comctl32.lib")
 #pragma comment(lib, "user32.lib")
@@ -17,8 +21,13 @@
 #define ID_BTN_SAVE  2005
 #define ID_BTN_LOAD  2006
 #define ID_BTN_SUMMARY 2004
+#define ID_BTN_FOLLOW 2007
+#define ID_BTN_COLUMN 2008
 #define ID_STATIC_SUMMARY 3001
 
+// Posted by the CSV follower thread; lParam is a FollowUpdate*
+#define WM_APP_FOLLOW_BATCH (WM_APP + 1)
+
 // Dialog control IDs
 #define IDC_EDIT_CATEGORY 4001
 #define IDC_EDIT_ITEM 4002
@@ -27,8 +36,11 @@
 #define IDC_EDIT_QUANTITY 4005
 #define IDC_EDIT_UNITCOST 4006
 #define IDC_EDIT_NOTES 4007
+#define IDC_EDIT_EXTRA 4100     // + index of the extra column
 #define IDC_BTN_OK 4008
 #define IDC_BTN_CANCEL 4009
+#define IDC_EDIT_COLUMN_NAME 4010
+#define IDC_EDIT_FORMULA 4011
 
 // Global variables
 DataTable* g_dataTable = nullptr;
@@ -38,11 +50,24 @@ HWND g_hBtnEdit = NULL;
 HWND g_hBtnSave = NULL;
 HWND g_hBtnLoad = NULL;
 HWND g_hBtnSummary = NULL;
+HWND g_hBtnFollow = NULL;
+HWND g_hBtnColumn = NULL;
 HWND g_hStaticSummary = NULL;
 
+// Follow mode: rows appended to a CSV by another program show up as they are written
+CsvFollower g_csvFollower;
+unsigned g_followSession = 0;   // batches from an earlier session are dropped
+
+struct FollowUpdate {
+    unsigned session;
+    CsvFollower::Batch batch;
+    std::vector<ImportIssue> issues;
+};
+
 // Dialog data
 DataRow g_dialogData;
 bool g_dialogResult = false;
+const size_t MAX_DIALOG_EXTRAS = 10;    // extra columns given an edit box in the entry dialog
 
 // Layout constants
 const int MARGIN = 10;
@@ -51,6 +76,9 @@ const int BUTTON_WIDTH = 120;
 const int SUMMARY_HEIGHT = 60;
 const int BUTTON_SPACING = 10;
 
+// CSV files at least this large are opened as paged sheets instead of being read into memory
+const unsigned long long PAGED_SHEET_BYTES = 512ull * 1024 * 1024;
+
 // --- Helper: dialogue box for saving ---
 bool ShowSaveCSVDialog(HWND hwnd, std::wstring& outPath)
 {
@@ -61,6 +89,7 @@ bool ShowSaveCSVDialog(HWND hwnd, std::wstring& outPath)
     ofn.hwndOwner   = hwnd;
     ofn.lpstrFilter =
         L"CSV Files (*.csv)\0*.csv\0"
+        L"Excel Workbook (*.xlsx)\0*.xlsx\0"
         L"All Files (*.*)\0*.*\0";
     ofn.lpstrFile   = fileName;
     ofn.nMaxFile    = MAX_PATH;
@@ -75,20 +104,19 @@ bool ShowSaveCSVDialog(HWND hwnd, std::wstring& outPath)
     return false;
 }
 
+// --- Helper: check whether a path names an Excel workbook ---
+bool IsXlsxPath(const std::wstring& path)
+{
+    if (path.size() < 5) return false;
+    std::wstring ext = path.substr(path.size() - 5);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::towlower);
+    return ext == L".xlsx";
+}
+
 // --- Helper function to validate float input ---
 bool IsValidFloat(const std::wstring& str) {
-    if (str.empty()) return false;
-    std::wstring trimmed = str;
-    trimmed.erase(0, trimmed.find_first_not_of(L" \t\n\r"));
-    trimmed.erase(trimmed.find_last_not_of(L" \t\n\r") + 1);
-    if (trimmed.empty()) return false;
-    try {
-        size_t pos = 0;
-        std::stod(trimmed, &pos);
-        return pos == trimmed.length();
-    } catch (...) {
-        return false;
-    }
+    double value = 0.0;
+    return ImportValidator::ParseNumber(str, value);
 }
 
 // --- Helper: dialogue box for loading ---
@@ -99,7 +127,7 @@ bool ShowOpenCSVDialog(HWND hwnd, std::wstring& outPath)
     OPENFILENAME ofn = {};
     ofn.lStructSize = sizeof(ofn);
     ofn.hwndOwner = hwnd;
-    ofn.lpstrFilter = L"CSV Files (*.csv)\0*.csv\0All Files (*.*)\0*.*\0";
+    ofn.lpstrFilter = L"CSV Files (*.csv)\0*.csv\0Excel Workbook (*.xlsx)\0*.xlsx\0All Files (*.*)\0*.*\0";
     ofn.lpstrFile = fileName;
     ofn.nMaxFile = MAX_PATH;
     ofn.Flags = OFN_EXPLORER | OFN_FILEMUSTEXIST | OFN_PATHMUSTEXIST;
@@ -114,23 +142,51 @@ bool ShowOpenCSVDialog(HWND hwnd, std::wstring& outPath)
     return false;
 }
 
+// --- Helper: size of a file in bytes (0 if it cannot be read) ---
+unsigned long long GetFileSizeBytes(const std::wstring& path)
+{
+    WIN32_FILE_ATTRIBUTE_DATA data = {};
+    if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &data))
+        return 0;
+    return (static_cast<unsigned long long>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+}
+
+// --- Helper: backing file for a paged sheet, in the temp folder ---
+std::wstring GetPagedBackingPath()
+{
+    wchar_t folder[MAX_PATH] = L"";
+    wchar_t path[MAX_PATH] = L"";
+    if (!GetTempPathW(MAX_PATH, folder) || !GetTempFileNameW(folder, L"cst", 0, path))
+        return L"";
+    return path;
+}
+
 // --- Helper: calculate total cost ---
 std::wstring CalculateCost(const std::wstring& quantity, const std::wstring& unitCost) {
-    try {
-        std::wstring ucStr = unitCost;
-        ucStr.erase(std::remove(ucStr.begin(), ucStr.end(), L'$'), ucStr.end());
-        ucStr.erase(std::remove(ucStr.begin(), ucStr.end(), L','), ucStr.end());
-
-        double qty = std::stod(quantity);
-        double uc = std::stod(ucStr);
-        double total = qty * uc;
-
-        std::wostringstream oss;
-        oss << L"$" << std::fixed << std::setprecision(2) << total;
-        return oss.str();
-    } catch (...) {
+    double qty = 0.0, uc = 0.0;
+    if (!ImportValidator::ParseNumber(quantity, qty) ||
+        !ImportValidator::ParseNumber(unitCost, uc, true))
         return L"$0.00";
+
+    return ImportValidator::FormatMoney(qty * uc);
+}
+
+// --- Helper: show problems found while importing a file ---
+void ShowImportIssues(HWND hwnd, const std::vector<ImportIssue>& issues, const TableSchema& schema) {
+    const size_t maxShown = 15;
+
+    std::wostringstream oss;
+    oss << issues.size() << L" problem(s) found while loading:\n\n";
+    for (size_t i = 0; i < issues.size() && i < maxShown; ++i) {
+        oss << L"Line " << issues[i].line;
+        if (issues[i].column >= 0 && static_cast<size_t>(issues[i].column) < schema.GetColumnCount())
+            oss << L", " << schema.GetColumn(issues[i].column).name;
+        oss << L": " << issues[i].message << L"\n";
     }
+    if (issues.size() > maxShown)
+        oss << L"\n...and " << (issues.size() - maxShown) << L" more.";
+
+    MessageBox(hwnd, oss.str().c_str(), L"Import Check", MB_OK | MB_ICONWARNING);
 }
 
 // --- Dialog Window Procedure ---
@@ -181,6 +237,14 @@ LRESULT CALLBACK DialogWindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lP
                     GetDlgItemText(hwnd, IDC_EDIT_NOTES, buffer, 256);
                     g_dialogData.notes = buffer;
 
+                    // Extra columns of the loaded sheet; ones without an edit box keep their value
+                    const TableSchema& schema = g_dataTable->GetSchema();
+                    g_dialogData.extra.resize(schema.GetExtraCount());
+                    for (size_t j = 0; j < schema.GetExtraCount() && j < MAX_DIALOG_EXTRAS; ++j) {
+                        GetDlgItemText(hwnd, IDC_EDIT_EXTRA + static_cast<int>(j), buffer, 256);
+                        g_dialogData.extra[j] = buffer;
+                    }
+
                     g_dialogData.cost = CalculateCost(g_dialogData.quantity, g_dialogData.unitCost);
 
                     g_dialogResult = true;
@@ -208,6 +272,9 @@ LRESULT CALLBACK DialogWindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lP
 
 // --- Create entry dialog programmatically ---
 HWND CreateEntryDialog(HWND hwndParent, bool isEdit) {
+    const TableSchema& schema = g_dataTable->GetSchema();
+    size_t extraCount = std::min(schema.GetExtraCount(), MAX_DIALOG_EXTRAS);
+
     static bool classRegistered = false;
     if (!classRegistered) {
         WNDCLASS wc = {};
@@ -225,7 +292,7 @@ HWND CreateEntryDialog(HWND hwndParent, bool isEdit) {
         L"EntryDialogClass",
         isEdit ? L"Edit Entry" : L"Add New Entry",
         WS_POPUP | WS_CAPTION | WS_SYSMENU | WS_VISIBLE,
-        CW_USEDEFAULT, CW_USEDEFAULT, 500, 400,
+        CW_USEDEFAULT, CW_USEDEFAULT, 500, 400 + 35 * static_cast<int>(extraCount),
         hwndParent, NULL, GetModuleHandle(NULL), NULL
     );
 
@@ -260,6 +327,23 @@ HWND CreateEntryDialog(HWND hwndParent, bool isEdit) {
         yPos += rowHeight;
     }
 
+    // One more box per extra column of the loaded sheet
+    size_t builtInColumns = schema.GetColumnCount() - schema.GetExtraCount();
+    for (size_t j = 0; j < extraCount; ++j) {
+        std::wstring label = schema.GetColumn(builtInColumns + j).name + L":";
+        CreateWindow(L"STATIC", label.c_str(),
+            WS_CHILD | WS_VISIBLE | SS_RIGHT,
+            xLabel, yPos + 3, labelWidth, 20,
+            hwndDlg, NULL, GetModuleHandle(NULL), NULL);
+
+        CreateWindowEx(WS_EX_CLIENTEDGE, L"EDIT", L"",
+            WS_CHILD | WS_VISIBLE | WS_TABSTOP | ES_AUTOHSCROLL,
+            xEdit, yPos, editWidth, 25,
+            hwndDlg, (HMENU)(LONG_PTR)(IDC_EDIT_EXTRA + static_cast<int>(j)), GetModuleHandle(NULL), NULL);
+
+        yPos += rowHeight;
+    }
+
     CreateWindow(L"BUTTON", L"OK",
         WS_CHILD | WS_VISIBLE | WS_TABSTOP | BS_DEFPUSHBUTTON,
         150, yPos + 20, 80, 30,
@@ -279,6 +363,8 @@ HWND CreateEntryDialog(HWND hwndParent, bool isEdit) {
         SetDlgItemText(hwndDlg, IDC_EDIT_QUANTITY, g_dialogData.quantity.c_str());
         SetDlgItemText(hwndDlg, IDC_EDIT_UNITCOST, g_dialogData.unitCost.c_str());
         SetDlgItemText(hwndDlg, IDC_EDIT_NOTES, g_dialogData.notes.c_str());
+        for (size_t j = 0; j < extraCount && j < g_dialogData.extra.size(); ++j)
+            SetDlgItemText(hwndDlg, IDC_EDIT_EXTRA + static_cast<int>(j), g_dialogData.extra[j].c_str());
     }
 
     return hwndDlg;
@@ -305,6 +391,151 @@ bool ShowEntryDialog(HWND hwndParent, DataRow& data, bool isEdit) {
     return g_dialogResult;
 }
 
+// --- Computed Column Dialog Window Procedure ---
+LRESULT CALLBACK ColumnDialogWindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+    switch (uMsg) {
+        case WM_COMMAND: {
+            switch (LOWORD(wParam)) {
+                case IDC_BTN_OK: {
+                    wchar_t buffer[512];
+
+                    GetDlgItemText(hwnd, IDC_EDIT_COLUMN_NAME, buffer, 512);
+                    std::wstring name = buffer;
+
+                    GetDlgItemText(hwnd, IDC_EDIT_FORMULA, buffer, 512);
+                    std::wstring formula = buffer;
+
+                    // The dialog stays open so the formula can be corrected
+                    std::wstring error;
+                    if (!g_dataTable->AddComputedColumn(name, formula, error)) {
+                        MessageBox(hwnd, error.c_str(), L"Invalid Column", MB_OK | MB_ICONERROR);
+                        SetFocus(GetDlgItem(hwnd, IDC_EDIT_FORMULA));
+                        return 0;
+                    }
+
+                    g_dialogResult = true;
+                    DestroyWindow(hwnd);
+                    return 0;
+                }
+
+                case IDC_BTN_CANCEL: {
+                    g_dialogResult = false;
+                    DestroyWindow(hwnd);
+                    return 0;
+                }
+            }
+            break;
+        }
+
+        case WM_CLOSE:
+            g_dialogResult = false;
+            DestroyWindow(hwnd);
+            return 0;
+    }
+
+    return DefWindowProc(hwnd, uMsg, wParam, lParam);
+}
+
+// --- Show the "Add Computed Column" dialog ---
+bool ShowComputedColumnDialog(HWND hwndParent) {
+    static bool classRegistered = false;
+    if (!classRegistered) {
+        WNDCLASS wc = {};
+        wc.lpfnWndProc = ColumnDialogWindowProc;
+        wc.hInstance = GetModuleHandle(NULL);
+        wc.lpszClassName = L"ColumnDialogClass";
+        wc.hbrBackground = (HBRUSH)(COLOR_BTNFACE + 1);
+        wc.hCursor = LoadCursor(NULL, IDC_ARROW);
+        RegisterClass(&wc);
+        classRegistered = true;
+    }
+
+    g_dialogResult = false;
+
+    HWND hwndDlg = CreateWindowEx(
+        WS_EX_DLGMODALFRAME | WS_EX_TOPMOST,
+        L"ColumnDialogClass",
+        L"Add Computed Column",
+        WS_POPUP | WS_CAPTION | WS_SYSMENU | WS_VISIBLE,
+        CW_USEDEFAULT, CW_USEDEFAULT, 500, 330,
+        hwndParent, NULL, GetModuleHandle(NULL), NULL
+    );
+
+    CreateWindow(L"STATIC", L"Name:",
+        WS_CHILD | WS_VISIBLE | SS_RIGHT,
+        20, 23, 100, 20,
+        hwndDlg, NULL, GetModuleHandle(NULL), NULL);
+
+    CreateWindowEx(WS_EX_CLIENTEDGE, L"EDIT", L"",
+        WS_CHILD | WS_VISIBLE | WS_TABSTOP | ES_AUTOHSCROLL,
+        130, 20, 330, 25,
+        hwndDlg, (HMENU)IDC_EDIT_COLUMN_NAME, GetModuleHandle(NULL), NULL);
+
+    CreateWindow(L"STATIC", L"Formula:",
+        WS_CHILD | WS_VISIBLE | SS_RIGHT,
+        20, 58, 100, 20,
+        hwndDlg, NULL, GetModuleHandle(NULL), NULL);
+
+    CreateWindowEx(WS_EX_CLIENTEDGE, L"EDIT", L"",
+        WS_CHILD | WS_VISIBLE | WS_TABSTOP | ES_AUTOHSCROLL,
+        130, 55, 330, 25,
+        hwndDlg, (HMENU)IDC_EDIT_FORMULA, GetModuleHandle(NULL), NULL);
+
+    CreateWindow(L"STATIC",
+        L"Use quantity, unitcost, cost and earlier computed columns with + - * / ( ).\n"
+        L"Functions: SUM(col), CATSUM(col), RUNSUM(col), ABS(x), ROUND(x, digits), MIN(a, b), MAX(a, b).\n"
+        L"Example: Tax = cost * 0.07, Share = cost / CATSUM(cost)",
+        WS_CHILD | WS_VISIBLE | SS_LEFT,
+        20, 95, 440, 110,
+        hwndDlg, NULL, GetModuleHandle(NULL), NULL);
+
+    CreateWindow(L"BUTTON", L"OK",
+        WS_CHILD | WS_VISIBLE | WS_TABSTOP | BS_DEFPUSHBUTTON,
+        150, 225, 80, 30,
+        hwndDlg, (HMENU)IDC_BTN_OK, GetModuleHandle(NULL), NULL);
+
+    CreateWindow(L"BUTTON", L"Cancel",
+        WS_CHILD | WS_VISIBLE | WS_TABSTOP | BS_PUSHBUTTON,
+        250, 225, 80, 30,
+        hwndDlg, (HMENU)IDC_BTN_CANCEL, GetModuleHandle(NULL), NULL);
+
+    EnableWindow(hwndParent, FALSE);
+
+    MSG msg;
+    while (IsWindow(hwndDlg) && GetMessage(&msg, NULL, 0, 0)) {
+        TranslateMessage(&msg);
+        DispatchMessage(&msg);
+    }
+
+    EnableWindow(hwndParent, TRUE);
+    SetForegroundWindow(hwndParent);
+    return g_dialogResult;
+}
+
+// --- Load a CSV too large for memory as a paged sheet ---
+bool LoadPagedCSV(const std::wstring& filePath, std::vector<ImportIssue>& issues, std::wstring& formulaError)
+{
+    std::unique_ptr<PagedRowStore> store(new PagedRowStore());
+    if (!store->Open(GetPagedBackingPath()))
+        return false;
+
+    // Each block of rows is checked and tidied before it is written to the store
+    TableSchema schema;
+    bool loaded = SpreadsheetStorage::LoadFromCSV(filePath, *store, &schema,
+        [&issues, &schema](std::vector<DataRow>& rows, const std::vector<size_t>& lineNumbers) {
+            std::vector<ImportIssue> blockIssues;
+            ImportValidator::ValidateAndNormalize(rows, lineNumbers, schema, blockIssues);
+            issues.insert(issues.end(), blockIssues.begin(), blockIssues.end());
+        }, &issues);
+    if (!loaded)
+        return false;
+
+    g_dataTable->Clear();
+    g_dataTable->SetSchema(schema, &formulaError);
+    g_dataTable->OpenPaged(std::move(store));
+    return true;
+}
+
 // --- Update summary ---
 void UpdateSummary() {
     if (!g_dataTable || !g_hStaticSummary) return;
@@ -319,6 +550,66 @@ void UpdateSummary() {
     SetWindowText(g_hStaticSummary, oss.str().c_str());
 }
 
+// --- Start or stop following a CSV file ---
+void ToggleFollow(HWND hwnd) {
+    if (g_csvFollower.IsRunning()) {
+        g_csvFollower.Stop();
+        SetWindowText(g_hBtnFollow, L"Follow");
+        return;
+    }
+
+    std::wstring filePath;
+    if (!ShowOpenCSVDialog(hwnd, filePath))
+        return;  // User cancelled
+
+    if (IsXlsxPath(filePath)) {
+        MessageBox(hwnd, L"Follow mode works with CSV files only.", L"Follow", MB_OK | MB_ICONWARNING);
+        return;
+    }
+
+    // Runs on the follower thread: validate there, then hand the rows to the UI thread
+    unsigned session = ++g_followSession;
+    bool started = g_csvFollower.Start(filePath, [hwnd, session](CsvFollower::Batch&& batch) {
+        FollowUpdate* update = new FollowUpdate();
+        update->session = session;
+        update->batch = std::move(batch);
+        update->issues = std::move(update->batch.issues);
+        ImportValidator::ValidateAndNormalize(update->batch.rows, update->batch.lineNumbers, update->batch.schema,
+                                              update->issues);
+        if (!PostMessage(hwnd, WM_APP_FOLLOW_BATCH, 0, reinterpret_cast<LPARAM>(update)))
+            delete update;
+    });
+
+    if (started)
+        SetWindowText(g_hBtnFollow, L"Stop Following");
+    else
+        MessageBox(hwnd, L"Could not open the file to follow.", L"Error", MB_OK | MB_ICONERROR);
+}
+
+// --- Apply rows read by the CSV follower (UI thread) ---
+void ApplyFollowUpdate(HWND hwnd, FollowUpdate* update) {
+    std::unique_ptr<FollowUpdate> owned(update);
+    if (!g_csvFollower.IsRunning() || owned->session != g_followSession)
+        return;  // Stopped (or restarted) while this batch was queued
+
+    std::wstring formulaError;
+    if (owned->batch.reload) {
+        g_dataTable->Clear();
+        g_dataTable->SetSchema(owned->batch.schema, &formulaError);
+    }
+    g_dataTable->AddRows(owned->batch.rows);
+
+    if (!owned->batch.reload && g_dataTable->GetRowCount() > 0)
+        ListView_EnsureVisible(g_dataTable->GetHandle(), g_dataTable->GetRowCount() - 1, FALSE);
+    UpdateSummary();
+
+    // Report problems once per full read rather than on every appended line
+    if (!formulaError.empty())
+        MessageBox(hwnd, formulaError.c_str(), L"Computed Columns", MB_OK | MB_ICONWARNING);
+    if (owned->batch.reload && !owned->issues.empty())
+        ShowImportIssues(hwnd, owned->issues, owned->batch.schema);
+}
+
 // --- Update layout ---
 void UpdateLayout(HWND hwnd) {
     RECT rc;
@@ -342,6 +633,8 @@ void UpdateLayout(HWND hwnd) {
     if (g_hBtnEdit) SetWindowPos(g_hBtnEdit, NULL, buttonX, buttonY, BUTTON_WIDTH, BUTTON_HEIGHT, SWP_NOZORDER);
     buttonX += BUTTON_WIDTH + BUTTON_SPACING;
     if (g_hBtnSummary) SetWindowPos(g_hBtnSummary, NULL, buttonX, buttonY, BUTTON_WIDTH + 20, BUTTON_HEIGHT, SWP_NOZORDER);
+    buttonX += BUTTON_WIDTH + 20 + BUTTON_SPACING;
+    if (g_hBtnColumn) SetWindowPos(g_hBtnColumn, NULL, buttonX, buttonY, BUTTON_WIDTH, BUTTON_HEIGHT, SWP_NOZORDER);
 
     int rightX = clientWidth - MARGIN;
 
@@ -356,6 +649,13 @@ void UpdateLayout(HWND hwnd) {
         rightX -= BUTTON_WIDTH;
         SetWindowPos(g_hBtnSave, NULL, rightX, buttonY,
             BUTTON_WIDTH, BUTTON_HEIGHT, SWP_NOZORDER);
+        rightX -= BUTTON_SPACING;
+    }
+
+    if (g_hBtnFollow) {
+        rightX -= BUTTON_WIDTH;
+        SetWindowPos(g_hBtnFollow, NULL, rightX, buttonY,
+            BUTTON_WIDTH, BUTTON_HEIGHT, SWP_NOZORDER);
     }
 
     if (g_hStaticSummary) SetWindowPos(g_hStaticSummary, NULL, MARGIN, summaryY, clientWidth - 2 * MARGIN, SUMMARY_HEIGHT, SWP_NOZORDER);
@@ -378,6 +678,8 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
             g_hBtnSummary = CreateWindowW(L"BUTTON", L"Calculate Summary", WS_TABSTOP | WS_VISIBLE | WS_CHILD | BS_DEFPUSHBUTTON, 0, 0, 100, 30, hwnd, (HMENU)ID_BTN_SUMMARY, GetModuleHandle(NULL), NULL);
             g_hBtnSave = CreateWindowW(L"BUTTON", L"Save", WS_TABSTOP | WS_VISIBLE | WS_CHILD | BS_PUSHBUTTON, 0, 0, 100, 30, hwnd, (HMENU)ID_BTN_SAVE, GetModuleHandle(NULL), NULL);
             g_hBtnLoad = CreateWindowW(L"BUTTON", L"Load", WS_TABSTOP | WS_VISIBLE | WS_CHILD | BS_PUSHBUTTON, 0, 0, 100, 30, hwnd, (HMENU)ID_BTN_LOAD, GetModuleHandle(NULL), NULL);
+            g_hBtnFollow = CreateWindowW(L"BUTTON", L"Follow", WS_TABSTOP | WS_VISIBLE | WS_CHILD | BS_PUSHBUTTON, 0, 0, 100, 30, hwnd, (HMENU)ID_BTN_FOLLOW, GetModuleHandle(NULL), NULL);
+            g_hBtnColumn = CreateWindowW(L"BUTTON", L"Add Column", WS_TABSTOP | WS_VISIBLE | WS_CHILD | BS_PUSHBUTTON, 0, 0, 100, 30, hwnd, (HMENU)ID_BTN_COLUMN, GetModuleHandle(NULL), NULL);
 
             g_hStaticSummary = CreateWindowEx(WS_EX_CLIENTEDGE, L"STATIC", L"", WS_CHILD | WS_VISIBLE | SS_LEFT | SS_CENTERIMAGE, 0, 0, 100, 50, hwnd, (HMENU)ID_STATIC_SUMMARY, GetModuleHandle(NULL), NULL);
 
@@ -434,6 +736,37 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
                         << L"\nTotal Cost: $" << std::fixed << std::setprecision(2) << totalCost
                         << L"\nAverage Cost per Entry: $" << (rowCount > 0 ? totalCost / rowCount : 0.0);
 
+                    // Median / p95 overall and per category, and the most expensive items
+                    CostAnalytics::Options options;
+                    options.topCount = 5;
+                    options.byCategory = true;
+                    CostAnalytics::Result analysis = g_dataTable->Analyze(options);
+
+                    if (analysis.overall.GetCount() > 0) {
+                        oss << L"\nMedian Cost: $" << analysis.overall.GetQuantile(0.5)
+                            << L"\n95th Percentile Cost: $" << analysis.overall.GetQuantile(0.95);
+
+                        oss << L"\n\nMost Expensive Items:";
+                        for (const auto& entry : analysis.top) {
+                            DataRow r;
+                            g_dataTable->GetRow(entry.index, r);
+                            oss << L"\n  " << (r.item.empty() ? r.description : r.item) << L": $" << entry.value;
+                        }
+
+                        const size_t maxCategories = 10;
+                        size_t shown = 0;
+                        oss << L"\n\nBy Category (median / p95):";
+                        for (const auto& category : analysis.categories) {
+                            if (shown++ == maxCategories) {
+                                oss << L"\n  ...";
+                                break;
+                            }
+                            oss << L"\n  " << (category.first.empty() ? L"(none)" : category.first)
+                                << L": $" << category.second.GetQuantile(0.5)
+                                << L" / $" << category.second.GetQuantile(0.95);
+                        }
+                    }
+
                     MessageBox(hwnd, oss.str().c_str(), L"Cost Summary", MB_OK | MB_ICONINFORMATION);
                     break;
                 }
@@ -443,7 +776,20 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 
                     if (ShowSaveCSVDialog(hwnd, filePath))
                     {
-                        if (SpreadsheetStorage::SaveToCSV(filePath, g_dataTable->GetAllRows()))
+                        // Computed columns are saved with their formulas and current values
+                        const FormulaEngine* formulas = &g_dataTable->GetFormulas();
+                        PagedRowStore* paged = g_dataTable->GetPagedRows();
+                        bool saved;
+                        if (paged)
+                            saved = IsXlsxPath(filePath)
+                                ? SpreadsheetStorage::SaveToXLSX(filePath, *paged, g_dataTable->GetSchema())
+                                : SpreadsheetStorage::SaveToCSV(filePath, *paged, g_dataTable->GetSchema());
+                        else
+                            saved = IsXlsxPath(filePath)
+                                ? SpreadsheetStorage::SaveToXLSX(filePath, g_dataTable->GetAllRows(), g_dataTable->GetSchema(), formulas)
+                                : SpreadsheetStorage::SaveToCSV(filePath, g_dataTable->GetAllRows(), g_dataTable->GetSchema(), formulas);
+
+                        if (saved)
                         {
                             MessageBox(hwnd, L"File saved successfully.",
                                     L"Saved", MB_OK | MB_ICONINFORMATION);
@@ -463,17 +809,45 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
                     if (!ShowOpenCSVDialog(hwnd, filePath))
                         break;  // User cancelled
 
-                    std::vector<DataRow> rows;
+                    // A manual load replaces whatever was being followed
+                    if (g_csvFollower.IsRunning()) {
+                        g_csvFollower.Stop();
+                        SetWindowText(g_hBtnFollow, L"Follow");
+                    }
 
-                    if (SpreadsheetStorage::LoadFromCSV(filePath, rows))
-                    {
-                        g_dataTable->Clear();
+                    std::vector<ImportIssue> issues;
+                    std::wstring formulaError;
+                    bool loaded;
+
+                    if (!IsXlsxPath(filePath) && GetFileSizeBytes(filePath) >= PAGED_SHEET_BYTES) {
+                        loaded = LoadPagedCSV(filePath, issues, formulaError);
+                    } else {
+                        std::vector<DataRow> rows;
+                        std::vector<size_t> lineNumbers;
+                        TableSchema schema;
 
-                        for (const auto& r : rows)
-                            g_dataTable->AddRow(r);
+                        loaded = IsXlsxPath(filePath)
+                            ? SpreadsheetStorage::LoadFromXLSX(filePath, rows, &schema)
+                            : SpreadsheetStorage::LoadFromCSV(filePath, rows, &lineNumbers, &schema, &issues);
 
+                        if (loaded) {
+                            ImportValidator::ValidateAndNormalize(rows, lineNumbers, schema, issues);
+
+                            g_dataTable->Clear();
+                            g_dataTable->SetSchema(schema, &formulaError);
+                            g_dataTable->AddRows(rows);
+                        }
+                    }
+
+                    if (loaded)
+                    {
                         InvalidateRect(g_dataTable->GetHandle(), NULL, TRUE);
                         UpdateWindow(g_dataTable->GetHandle());
+
+                        if (!formulaError.empty())
+                            MessageBox(hwnd, formulaError.c_str(), L"Computed Columns", MB_OK | MB_ICONWARNING);
+                        if (!issues.empty())
+                            ShowImportIssues(hwnd, issues, g_dataTable->GetSchema());
                     }
                     else {
                         MessageBox(hwnd, L"Load failed.", L"Error", MB_OK | MB_ICONERROR);
@@ -481,15 +855,34 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
                     break;
                 }
 
+                case ID_BTN_FOLLOW:
+                    ToggleFollow(hwnd);
+                    break;
+
+                case ID_BTN_COLUMN:
+                    ShowComputedColumnDialog(hwnd);
+                    break;
+
             }
             return 0;
         }
 
+        case WM_NOTIFY:
+            // Rows of the virtual list view are supplied on demand
+            if (g_dataTable && g_dataTable->HandleNotify(reinterpret_cast<const NMHDR*>(lParam)))
+                return 0;
+            break;
+
+        case WM_APP_FOLLOW_BATCH:
+            ApplyFollowUpdate(hwnd, reinterpret_cast<FollowUpdate*>(lParam));
+            return 0;
+
         case WM_SIZE:
             UpdateLayout(hwnd);
             return 0;
 
         case WM_DESTROY:
+            g_csvFollower.Stop();
             delete g_dataTable;
             PostQuitMessage(0);
             return 0;
@@ -511,7 +904,7 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
     RegisterClass(&wc);
 
     HWND hwnd = CreateWindowEx(0, CLASS_NAME, L"Cost Tracker - Spreadsheet",
-        WS_OVERLAPPEDWINDOW, CW_USEDEFAULT, CW_USEDEFAULT, 950, 550,
+        WS_OVERLAPPEDWINDOW, CW_USEDEFAULT, CW_USEDEFAULT, 1100, 550,
         NULL, NULL, hInstance, NULL);
 
     if (!hwnd) return 0;
@@ -0,0 +1,174 @@
+//Check for PagedRowStore: loads a CSV through SpreadsheetStorage into a store whose page cache holds only a few
+//pages, so nearly every page is evicted to the backing file and read back. Rows read back (single rows, windows
+//as the list view asks for them, and a full ForEachRow pass) must match the file, including after updates that
+//split pages and erases that empty them. Build from the repository root, e.g.
+//  g++ -std=c++17 -O2 -pthread -I. tests/PagedRowStoreTest.cpp PagedRowStore.cpp SpreadsheetStorage.cpp
+//      TableSchema.cpp FormulaEngine.cpp ImportValidator.cpp ZipArchive.cpp AtomicFile.cpp -o PagedRowStoreTest
+//Exits with 0 when every check passes.
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "PagedRowStore.h"
+#include "SpreadsheetStorage.h"
+#include "TextEncoding.h"
+
+namespace {
+
+const size_t kRowCount = 20000;
+const wchar_t kCsvPath[] = L"PagedRowStoreTest.csv";
+const wchar_t kSavedPath[] = L"PagedRowStoreTest.saved.csv";
+const wchar_t kWorkbookPath[] = L"PagedRowStoreTest.saved.xlsx";
+const wchar_t kBackingPath[] = L"PagedRowStoreTest.pages";
+
+int failures = 0;
+
+void Check(bool condition, const char* what)
+{
+    if (!condition) {
+        failures++;
+        std::printf("FAILED: %s\n", what);
+    }
+}
+
+DataRow MakeRow(size_t i)
+{
+    DataRow row{};
+    row.category = L"Category " + std::to_wstring(i % 7);
+    row.item = L"Item " + std::to_wstring(i);
+    row.material = i % 5 == 0 ? L"Café, €" : L"Steel";
+    row.description = std::wstring(i % 40, L'x');
+    row.quantity = std::to_wstring(i % 9 + 1);
+    row.unitCost = L"$2.00";
+    row.cost = L"$" + std::to_wstring(2 * (i % 9 + 1)) + L".00";
+    row.notes = i % 3 == 0 ? L"" : L"note " + std::to_wstring(i);
+    row.extra.push_back(L"Supplier " + std::to_wstring(i % 11));
+    return row;
+}
+
+bool SameRow(const DataRow& a, const DataRow& b)
+{
+    return a.category == b.category && a.item == b.item && a.material == b.material
+        && a.description == b.description && a.quantity == b.quantity && a.unitCost == b.unitCost
+        && a.cost == b.cost && a.notes == b.notes && a.extra == b.extra;
+}
+
+bool WriteSourceCsv(const std::vector<DataRow>& rows)
+{
+    TableSchema schema = TableSchema::CostTracker();
+    schema.AddColumn(L"Supplier", ColumnType::Text);
+    return SpreadsheetStorage::SaveToCSV(kCsvPath, rows, schema);
+}
+
+// Compare the store with the expected rows through every read path
+void CheckContents(PagedRowStore& store, const std::vector<DataRow>& expected, const char* stage)
+{
+    std::printf("%s: %zu rows, %zu bytes cached\n", stage, store.GetRowCount(), store.GetResidentBytes());
+    Check(store.GetRowCount() == expected.size(), "row count");
+
+    size_t mismatches = 0;
+    DataRow row;
+    for (size_t i = 0; i < expected.size(); i += 97) {
+        if (!store.GetRow(i, row) || !SameRow(row, expected[i]))
+            mismatches++;
+    }
+
+    // Windows as a virtual list view requests them: scattered, then scrolling backwards
+    std::vector<DataRow> window;
+    for (size_t step = 0; step * 1733 < expected.size(); step++) {
+        size_t first = expected.size() - 1 - step * 1733;
+        size_t copied = store.GetRows(first, 50, window);
+        for (size_t r = 0; r < copied; r++) {
+            if (!SameRow(window[r], expected[first + r]))
+                mismatches++;
+        }
+        if (copied != std::min<size_t>(50, expected.size() - first))
+            mismatches++;
+    }
+
+    size_t visited = 0;
+    store.ForEachRow([&](size_t index, const DataRow& current) {
+        if (index != visited++ || !SameRow(current, expected[index]))
+            mismatches++;
+        return true;
+    });
+    Check(visited == expected.size(), "ForEachRow visits every row");
+    Check(mismatches == 0, "rows read back match");
+}
+
+} // namespace
+
+int main()
+{
+    std::vector<DataRow> expected;
+    for (size_t i = 0; i < kRowCount; i++)
+        expected.push_back(MakeRow(i));
+    Check(WriteSourceCsv(expected), "write source CSV");
+
+    // Small pages and a cache of four of them, so nearly every read comes from the backing file
+    PagedRowStore::Options options;
+    options.pageSize = 4096;
+    options.memoryLimit = 4 * 4096;
+    options.prefetchPages = 2;
+
+    PagedRowStore store;
+    Check(store.Open(kBackingPath, options), "open backing file");
+
+    TableSchema schema;
+    size_t blocks = 0;
+    bool loaded = SpreadsheetStorage::LoadFromCSV(kCsvPath, store, &schema,
+        [&blocks](std::vector<DataRow>&, const std::vector<size_t>&) {
+            blocks++;
+        });
+    Check(loaded, "load CSV into the store");
+    Check(blocks > 0, "rows delivered in blocks");
+    Check(schema.GetExtraCount() == 1, "extra column mapped");
+    Check(store.GetResidentBytes() <= 8 * options.pageSize, "page cache stays within its limit");
+    CheckContents(store, expected, "loaded");
+
+    // Updates that grow rows split their pages
+    for (size_t i = 0; i < expected.size(); i += 501) {
+        expected[i].notes = std::wstring(1500, L'n');
+        Check(store.UpdateRow(i, expected[i]), "update row");
+    }
+    CheckContents(store, expected, "updated");
+
+    // Erase a whole run of rows, emptying the pages that held them
+    for (size_t n = 0; n < 300; n++) {
+        Check(store.EraseRow(1000), "erase row");
+        expected.erase(expected.begin() + 1000);
+    }
+    Check(store.EraseRow(expected.size() - 1), "erase last row");
+    expected.pop_back();
+    Check(!store.EraseRow(expected.size()), "erase past the end fails");
+    CheckContents(store, expected, "erased");
+
+    // Saving streams the store back out a block at a time
+    TableSchema savedSchema = schema;
+    Check(SpreadsheetStorage::SaveToCSV(kSavedPath, store, savedSchema), "save from the store");
+    std::vector<DataRow> saved;
+    Check(SpreadsheetStorage::LoadFromCSV(kSavedPath, saved), "reload saved CSV");
+    size_t savedMismatches = saved.size() == expected.size() ? 0 : 1;
+    for (size_t i = 0; i < saved.size() && i < expected.size(); i++) {
+        if (!SameRow(saved[i], expected[i]))
+            savedMismatches++;
+    }
+    Check(savedMismatches == 0, "saved file matches the store");
+
+    Check(SpreadsheetStorage::SaveToXLSX(kWorkbookPath, store, savedSchema), "save workbook from the store");
+    Check(SpreadsheetStorage::LoadFromXLSX(kWorkbookPath, saved) && saved.size() == expected.size()
+        && saved.back().item == expected.back().item, "saved workbook matches the store");
+
+    store.Close();
+    std::remove(WideToUtf8(kCsvPath).c_str());
+    std::remove(WideToUtf8(kSavedPath).c_str());
+    std::remove(WideToUtf8(kWorkbookPath).c_str());
+
+    if (failures > 0) {
+        std::printf("PagedRowStoreTest: %d check(s) failed\n", failures);
+        return 1;
+    }
+    std::printf("PagedRowStoreTest passed\n");
+    return 0;
+}
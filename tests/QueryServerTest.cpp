@@ -0,0 +1,247 @@
+//Check for QueryServer: answers to each command of the protocol through Execute, BATCH, responses to pipelined
+//requests coming back in request order (through Execute, and over a socket with several workers and small jobs),
+//and a sheet reloaded with different columns never being seen with its old rows or half-published. Build from
+//the repository root, e.g.
+//  g++ -std=c++17 -O2 -pthread -I. tests/QueryServerTest.cpp QueryServer.cpp VersionedRowStore.cpp
+//      CostAnalytics.cpp TableSchema.cpp ImportValidator.cpp -o QueryServerTest
+//Exits with 0 when every check passes.
+
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+#include "QueryServer.h"
+#include "VersionedRowStore.h"
+
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+int failures = 0;
+
+void Check(bool condition, const char* what)
+{
+    if (!condition) {
+        failures++;
+        std::printf("FAILED: %s\n", what);
+    }
+}
+
+void CheckResponse(const std::string& actual, const std::string& expected, const char* what)
+{
+    Check(actual == expected, what);
+    if (actual != expected)
+        std::printf("  expected:\n%s  got:\n%s", expected.c_str(), actual.c_str());
+}
+
+bool StartsWith(const std::string& text, const std::string& prefix)
+{
+    return text.compare(0, prefix.size(), prefix) == 0;
+}
+
+DataRow MakeRow(const wchar_t* category, const wchar_t* item, int quantity, const wchar_t* supplier)
+{
+    DataRow row{};
+    row.category = category;
+    row.item = item;
+    row.quantity = std::to_wstring(quantity);
+    row.unitCost = L"$2.00";
+    row.cost = L"$" + std::to_wstring(2 * quantity) + L".00";
+    row.extra.push_back(supplier);
+    return row;
+}
+
+TableSchema SupplierSchema()
+{
+    TableSchema schema;
+    schema.AddColumn(L"Supplier");
+    return schema;
+}
+
+void CheckCommands(QueryServer& server)
+{
+    CheckResponse(server.Execute("PING\n"), "OK 0\n", "PING");
+    CheckResponse(server.Execute("ping"), "OK 0\n", "commands are case-insensitive, last newline optional");
+    CheckResponse(server.Execute("SUMMARY\n"), "OK 1\n3\t12.00\t4.00\t6.00\n", "SUMMARY");
+
+    CheckResponse(server.Execute("GROUPBY Category\n"),
+        "OK 2\nLumber\t2\t10.00\nPaint\t1\t2.00\n", "GROUPBY sorts groups by key");
+    CheckResponse(server.Execute("GROUPBY supplier\n"),
+        "OK 2\nAcme\t2\t6.00\nBolt & Co\t1\t6.00\n", "GROUPBY on an extra column");
+
+    CheckResponse(server.Execute("FILTER Cost > 3\n"),
+        "OK 2 2\n1\tLumber,Board,,,2,$2.00,$4.00,,Acme\n2\tLumber,Beam,,,3,$2.00,$6.00,,Bolt & Co\n",
+        "FILTER compares money as numbers");
+    CheckResponse(server.Execute("FILTER Supplier ~ \"bolt &\" 5\n"),
+        "OK 1 1\n2\tLumber,Beam,,,3,$2.00,$6.00,,Bolt & Co\n", "FILTER contains, quoted argument and limit");
+    CheckResponse(server.Execute("FILTER Item != Board 1\n"),
+        "OK 1 2\n0\tPaint,Brush,,,1,$2.00,$2.00,,Acme\n", "FILTER limit counts every match");
+
+    CheckResponse(server.Execute("ROWS 1 5\n"),
+        "OK 2\n1\tLumber,Board,,,2,$2.00,$4.00,,Acme\n2\tLumber,Beam,,,3,$2.00,$6.00,,Bolt & Co\n",
+        "ROWS clamps to the table");
+    CheckResponse(server.Execute("ROWS 9 1\n"), "OK 0\n", "ROWS past the end");
+
+    Check(StartsWith(server.Execute("GROUPBY Colour\n"), "ERR unknown column 'Colour'"), "unknown column");
+    Check(StartsWith(server.Execute("FILTER Cost ? 3\n"), "ERR usage: FILTER"), "bad FILTER operator");
+    Check(StartsWith(server.Execute("ROWS one 2\n"), "ERR usage: ROWS"), "bad ROWS count");
+    Check(StartsWith(server.Execute("DELETE 1\n"), "ERR unknown command 'DELETE'"), "unknown command");
+}
+
+void CheckPipelining(QueryServer& server)
+{
+    // Every line gets its response, in order, errors included; blank lines are skipped
+    CheckResponse(server.Execute("PING\nROWS 0 1\n\nBOGUS\nSUMMARY\nPING\n"),
+        "OK 0\n"
+        "OK 1\n0\tPaint,Brush,,,1,$2.00,$2.00,,Acme\n"
+        "ERR unknown command 'BOGUS'\n"
+        "OK 1\n3\t12.00\t4.00\t6.00\n"
+        "OK 0\n",
+        "pipelined responses come back in request order");
+
+    // BATCH itself has no response; the lines it covers are answered in order
+    CheckResponse(server.Execute("BATCH 2\nROWS 2 1\nPING\n"),
+        "OK 1\n2\tLumber,Beam,,,3,$2.00,$6.00,,Bolt & Co\nOK 0\n", "BATCH answers the lines it covers");
+    Check(StartsWith(server.Execute("BATCH many\n"), "ERR usage: BATCH"), "bad BATCH count");
+    Check(StartsWith(server.Execute("BATCH 10001\n"), "ERR usage: BATCH"), "BATCH over the limit");
+}
+
+#ifdef __linux__
+// Many ROWS requests written at once: with small jobs spread over several workers,
+// the responses must still come back in the order the requests were sent
+void CheckSocketPipelining(VersionedRowStore& store)
+{
+    QueryServer server(store);
+    QueryServer::Options options;
+    options.port = 0;
+    options.workerCount = 4;
+    options.maxJobRequests = 3;
+    if (!server.Start(options)) {
+        Check(false, "server starts on a free port");
+        return;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(server.GetPort());
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        Check(false, "connect to the server");
+        if (fd >= 0)
+            close(fd);
+        return;
+    }
+
+    const size_t kRequests = 300;
+    std::string requests, expected;
+    for (size_t i = 0; i < kRequests; i++) {
+        if (i % 50 == 25) {
+            requests += "BATCH 2\nROWS " + std::to_string(i % 3) + " 1\nPING\n";
+            expected += server.Execute("ROWS " + std::to_string(i % 3) + " 1\nPING\n");
+        }
+        std::string request = i % 7 == 0 ? "SUMMARY\n" : "ROWS " + std::to_string(i % 3) + " 1\n";
+        requests += request;
+        expected += server.Execute(request);
+    }
+
+    size_t sent = 0;
+    while (sent < requests.size()) {
+        ssize_t n = send(fd, requests.data() + sent, requests.size() - sent, 0);
+        if (n <= 0)
+            break;
+        sent += static_cast<size_t>(n);
+    }
+    shutdown(fd, SHUT_WR);
+
+    std::string received;
+    char buffer[4096];
+    ssize_t n;
+    while ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0)
+        received.append(buffer, static_cast<size_t>(n));
+    close(fd);
+    server.Stop();
+
+    Check(sent == requests.size(), "send pipelined requests");
+    Check(received == expected, "socket responses come back in request order");
+}
+#endif
+
+// A reader must see each reload's rows with that reload's columns: never the new columns
+// over the old rows, and never the empty table between clearing and refilling
+void CheckReloadConsistency()
+{
+    std::vector<DataRow> supplierRows, plainRows;
+    for (int i = 0; i < 200; i++)
+        supplierRows.push_back(MakeRow(L"Lumber", L"Board", 1, L"Acme"));
+    for (int i = 0; i < 300; i++)
+        plainRows.push_back(DataRow{ L"Paint", L"Brush", L"", L"", L"1", L"$1.00", L"$1.00", L"", {} });
+
+    VersionedRowStore store;
+    store.Replace(supplierRows, SupplierSchema());
+    QueryServer server(store);
+
+    std::atomic<bool> done{ false };
+    std::thread writer([&]() {
+        for (int i = 0; i < 2000; i++) {
+            if (i % 2 == 0)
+                store.Replace(plainRows, TableSchema::CostTracker());
+            else
+                store.Replace(supplierRows, SupplierSchema());
+        }
+        done = true;
+    });
+
+    const std::string withSupplier = "OK 1\nAcme\t200\t400.00\nOK 1\n200\t400.00\t2.00\t2.00\n";
+    const std::string withoutSupplier = "ERR unknown column 'Supplier'\nOK 1\n300\t300.00\t1.00\t1.00\n";
+    size_t answers = 0, mismatched = 0;
+    while (!done || answers == 0) {
+        std::string response = server.Execute("GROUPBY Supplier\nSUMMARY\n");
+        if (response != withSupplier && response != withoutSupplier)
+            mismatched++;
+        answers++;
+    }
+    writer.join();
+
+    std::printf("%zu answers during reloads\n", answers);
+    Check(mismatched == 0, "rows and columns of a reload are seen together");
+}
+
+} // namespace
+
+int main()
+{
+    VersionedRowStore store;
+    store.Replace({
+        MakeRow(L"Paint", L"Brush", 1, L"Acme"),
+        MakeRow(L"Lumber", L"Board", 2, L"Acme"),
+        MakeRow(L"Lumber", L"Beam", 3, L"Bolt & Co"),
+    }, SupplierSchema());
+
+    QueryServer server(store);
+    CheckCommands(server);
+    CheckPipelining(server);
+
+    // Cached answers follow the store: an edit is a new version
+    store.Append(MakeRow(L"Paint", L"Roller", 4, L"Acme"));
+    CheckResponse(server.Execute("SUMMARY\n"), "OK 1\n4\t20.00\t4.00\t8.00\n", "SUMMARY after an edit");
+    store.Erase(3);
+
+#ifdef __linux__
+    CheckSocketPipelining(store);
+#endif
+    CheckReloadConsistency();
+
+    if (failures > 0) {
+        std::printf("QueryServerTest: %d check(s) failed\n", failures);
+        return 1;
+    }
+    std::printf("QueryServerTest passed\n");
+    return 0;
+}
@@ -0,0 +1,220 @@
+//Stress check for VersionedRowStore. One writer appends, updates, erases and clears rows while reader threads take
+//snapshots, each holding several at once so that more are pinned than there are fixed reader slots and the overflow
+//slots are used too.
+//The writer records the row count and checksum of every version it publishes. Each reader checks that its snapshot
+//matches the record for its version, holds the snapshot while the writer keeps publishing and reclaiming, then
+//checks it again: a chunk reclaimed or changed while pinned shows up as a changed checksum (or, under
+//-fsanitize=address, as a use after free). Build from the repository root, e.g.
+//  g++ -std=c++17 -O2 -pthread -I. tests/VersionedRowStoreStress.cpp VersionedRowStore.cpp TableSchema.cpp
+//      ImportValidator.cpp -o VersionedRowStoreStress
+//Exits with 0 when every check passes.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+#include "VersionedRowStore.h"
+
+namespace {
+
+const size_t kReaderThreads = 24;
+const size_t kHeldSnapshots = 3;        // per reader; 72 in all, more than the store's fixed reader slots
+const size_t kWriterOps = 5000;
+const size_t kMaxRows = 3000;           // the writer clears the store past this
+
+struct Expected {
+    size_t rowCount;
+    uint64_t checksum;
+};
+
+// Indexed by version; entries up to recordedVersion are complete
+std::vector<Expected> expectedByVersion(kWriterOps + 1);
+std::atomic<uint64_t> recordedVersion{ 0 };
+std::atomic<bool> writerDone{ false };
+std::atomic<size_t> failures{ 0 };
+std::atomic<size_t> snapshotsChecked{ 0 };
+
+uint64_t HashRow(uint64_t hash, size_t index, const DataRow& row)
+{
+    hash ^= index + 0x9E3779B97F4A7C15ull;
+    for (wchar_t ch : row.item)
+        hash = (hash ^ static_cast<uint64_t>(ch)) * 1099511628211ull;
+    for (wchar_t ch : row.cost)
+        hash = (hash ^ static_cast<uint64_t>(ch)) * 1099511628211ull;
+    return hash;
+}
+
+uint64_t Checksum(const std::vector<DataRow>& rows)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < rows.size(); i++)
+        hash = HashRow(hash, i, rows[i]);
+    return hash;
+}
+
+uint64_t Checksum(const VersionedRowStore::Snapshot& snapshot)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < snapshot.GetRowCount(); i++)
+        hash = HashRow(hash, i, snapshot.GetRow(i));
+    return hash;
+}
+
+DataRow MakeRow(uint64_t id)
+{
+    DataRow row{};
+    row.item = L"Item " + std::to_wstring(id);
+    row.cost = L"$" + std::to_wstring(id % 1000) + L".00";
+    return row;
+}
+
+void Fail(const char* what, uint64_t version)
+{
+    failures++;
+    std::printf("FAILED: %s (version %llu)\n", what, static_cast<unsigned long long>(version));
+}
+
+// Applies each edit to the store and to a plain copy, and records what every version must contain
+void Writer(VersionedRowStore& store)
+{
+    std::vector<DataRow> model;
+    uint64_t version = 0;
+    uint64_t nextId = 0;
+    uint64_t random = 88172645463325252ull;
+
+    for (size_t op = 0; op < kWriterOps; op++) {
+        random ^= random << 13;
+        random ^= random >> 7;
+        random ^= random << 17;
+        unsigned choice = static_cast<unsigned>(random % 100);
+
+        if (model.size() > kMaxRows) {
+            store.Clear();
+            model.clear();
+        } else if (choice < 40 || model.empty()) {
+            DataRow row = MakeRow(nextId++);
+            store.Append(row);
+            model.push_back(row);
+        } else if (choice < 60) {
+            std::vector<DataRow> batch;
+            for (size_t n = random % 1000 + 1; n > 0; n--)
+                batch.push_back(MakeRow(nextId++));
+            store.Append(batch);
+            model.insert(model.end(), batch.begin(), batch.end());
+        } else if (choice < 85) {
+            size_t index = static_cast<size_t>(random >> 20) % model.size();
+            model[index] = MakeRow(nextId++);
+            if (!store.Update(index, model[index]))
+                Fail("update in range refused", version + 1);
+        } else {
+            size_t index = static_cast<size_t>(random >> 20) % model.size();
+            model.erase(model.begin() + static_cast<std::ptrdiff_t>(index));
+            if (!store.Erase(index))
+                Fail("erase in range refused", version + 1);
+        }
+
+        version++;
+        expectedByVersion[version] = { model.size(), Checksum(model) };
+        recordedVersion.store(version);
+    }
+    writerDone = true;
+}
+
+bool LookupExpected(uint64_t version, Expected& out)
+{
+    if (version > kWriterOps)
+        return false;
+
+    // The writer records a version just after publishing it, so wait briefly for it
+    while (recordedVersion.load() < version)
+        std::this_thread::yield();
+    out = expectedByVersion[version];
+    return true;
+}
+
+void CheckSnapshot(const VersionedRowStore::Snapshot& snapshot, uint64_t checksum)
+{
+    uint64_t version = snapshot.GetVersion();
+    if (version == 0)
+        return;     // the empty version before the first edit
+
+    Expected expected;
+    if (!LookupExpected(version, expected))
+        Fail("snapshot version was never published", version);
+    else if (snapshot.GetRowCount() != expected.rowCount || checksum != expected.checksum)
+        Fail("snapshot does not match its version", version);
+    snapshotsChecked++;
+}
+
+void Reader(const VersionedRowStore& store, size_t id)
+{
+    std::vector<VersionedRowStore::Snapshot> held(kHeldSnapshots);
+    std::vector<uint64_t> checksums(kHeldSnapshots);
+
+    while (!writerDone) {
+        for (size_t s = 0; s < kHeldSnapshots; s++) {
+            held[s] = store.GetSnapshot();
+            checksums[s] = Checksum(held[s]);
+            CheckSnapshot(held[s], checksums[s]);
+            if (s > 0 && held[s].GetVersion() < held[s - 1].GetVersion())
+                Fail("newer snapshot has an older version", held[s].GetVersion());
+        }
+
+        // Hold the snapshots while the writer publishes and reclaims, then read them again
+        std::this_thread::sleep_for(std::chrono::microseconds(500 + id * 50));
+        for (size_t s = 0; s < kHeldSnapshots; s++) {
+            if (Checksum(held[s]) != checksums[s])
+                Fail("pinned snapshot changed", held[s].GetVersion());
+            held[s] = VersionedRowStore::Snapshot();
+        }
+    }
+}
+
+} // namespace
+
+int main()
+{
+    // One thread holding more snapshots than there are fixed reader slots must not wait on itself
+    {
+        VersionedRowStore crowded;
+        std::vector<VersionedRowStore::Snapshot> many;
+        for (size_t i = 0; i < 100; i++) {
+            many.push_back(crowded.GetSnapshot());
+            crowded.Append(MakeRow(i));
+        }
+        for (size_t i = 0; i < many.size(); i++) {
+            if (many[i].GetRowCount() != i)
+                Fail("snapshot held by one thread changed", many[i].GetVersion());
+        }
+    }
+
+    VersionedRowStore store;
+
+    std::vector<std::thread> readers;
+    for (size_t id = 0; id < kReaderThreads; id++)
+        readers.emplace_back(Reader, std::cref(store), id);
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread writer(Writer, std::ref(store));
+    writer.join();
+    for (auto& reader : readers)
+        reader.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Every snapshot is gone, so a final edit reclaims everything retired; the store must still read back
+    store.Append(MakeRow(0));
+    if (store.GetSnapshot().GetRowCount() == 0)
+        Fail("store empty after final append", 0);
+
+    std::printf("%zu writes, %zu snapshots checked by %zu readers in %.1f s\n",
+        kWriterOps, snapshotsChecked.load(), kReaderThreads, seconds);
+    if (failures > 0) {
+        std::printf("VersionedRowStoreStress: %zu check(s) failed\n", failures.load());
+        return 1;
+    }
+    std::printf("VersionedRowStoreStress passed\n");
+    return 0;
+}